@@ -1,1431 +1,5914 @@
-/********************************************************************************************************************************************************
- *
- * File Name: fsaccess.c
- *
- * How to execute this file:
- * 	gcc -o output_file_name fsaccess.c
- *  	./output_file_name
- *  		This will give a prompt ">>"
- * 		What inputs to be given:
- *   		initfs <fsize> <total_num_of_inodes>
- *   		cpin <external_sourceFilePath> <destination_path>
- *   		cpout <internal_sourceFilePath> <external_destPath>
- *   		mkdir <DirectoryPath>
- *   		rm <FilePath>
- *   		Type q to exit
- * Description:
- *  Implementation of Unix V6 filesystem
- *
- * Authors:
- *  Name                    
- *  Kavitha Rajendran       
- *  Rajkumar Panneer Selvam   
- *
-*********************************************************************************************************************************************************/
-
-#include <stdio.h> 
-#include <fcntl.h> 
-#include <sys/stat.h> 
-#include <string.h> 
-#include <stdlib.h> 
-#include <math.h>
-#define MAX 1024
-
-//SuperBlock Structure
-typedef struct super_block
-{
-    unsigned short isize;
-    unsigned short fsize;
-    unsigned short nfree;
-    unsigned short free[100];
-    unsigned short ninode;
-    unsigned short inode[100];
-    char flock;
-    char ilock;
-    char fmod;
-    unsigned short time[2];
-}super_block;
-
-//Inode structure
-typedef struct inode 
-{
-    unsigned short flags;
-    char nlinks;
-    char uid;
-    char gid;
-    char size0;
-    unsigned short size1;
-    unsigned short addr[8];
-    unsigned short actime[2];
-    unsigned short modtime[2];
-}inode;
-
-//One entry in a data block if file type is directory; First 2 bytes --> File inode number; remaining 16 bytes --> Filename
-typedef struct dir 
-{
-    unsigned short inode_no;
-    char file_name[14];
-}dir;
-
-//File descriptor of V6FileSystem 
-int fd;
-
-super_block superblock = {0};
-inode current_inode;
-
-//This function returns the next available free block
-unsigned short getFreeBlockk() 
-{
-    unsigned short freeBlock;
-    lseek(fd, 512, SEEK_SET);
-   
-    read(fd, & superblock, sizeof(super_block));
-
-    if (superblock.nfree > 0) 
-    {
-    
-        freeBlock = superblock.free[superblock.nfree];
-        superblock.nfree--;
-        lseek(fd, 512, SEEK_SET);
-        write(fd, & superblock, sizeof(superblock));
-    } 
-    else 
-    {
-        freeBlock = superblock.free[superblock.nfree];
-        if (freeBlock == 0) 
-		{
-            printf(" Free Block over \n ");
-            return 0;
-        }
-        int curpos = lseek(fd, 512 * superblock.free[superblock.nfree], SEEK_SET);
-        unsigned short data;
-        read(fd, & superblock.nfree, sizeof(superblock.nfree));
-        int i;
-        for (i = 0; i <= superblock.nfree; i++)
-		{
-            ssize_t bytes_read;
-            bytes_read = read(fd, & data, sizeof(data));
-
-            superblock.free[i] = data;
-
-        }
-        lseek(fd, 512, SEEK_SET);
-        write(fd, & superblock, sizeof(superblock));
-
-		lseek(fd, curpos, SEEK_SET);
-		data = 0;
-		write(fd, & data, 2);
-		lseek(fd, curpos, SEEK_SET);
-    }
-	return freeBlock;
-}
-
-// Initializes the file system with the given total number of blocks & total number of inodes
-// Also initializes the super block contents & creates root directory
-initializeFS(int totalBlocks, int no_of_Inodes)
-{
-
-	fd = open("V6FileSystem", O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
-
-	initializeSuperBlock(totalBlocks, no_of_Inodes);
-
-	initializeRootInode();
-    
-    printf(" V6FileSystem initialized successfully \n");
-}
-
-//Initialize the inode for root directory
-initializeRootInode()
-{
-	int offset = 512 * 2;
-	int curpos = lseek(fd, offset, SEEK_SET);
-
-	inode rootInodeData;
-	ssize_t bytes_read = read(fd, & rootInodeData, sizeof(inode));
-	setAllocatedBitINode( & rootInodeData);
-
-	setDirectoryTypeFile( & rootInodeData);
-
-	dir dirData;
-	dirData.inode_no = 1;
-	strcpy(dirData.file_name, ".");
-
-	writeDirBlock(fd, & dirData, & rootInodeData);
-
-	dirData.inode_no = 1;
-	strcpy(dirData.file_name, "..");
-	writeDirBlock(fd, & dirData, & rootInodeData);
-
-	curpos = lseek(fd, 512 * 2, SEEK_SET);
-
-	bytes_read = write(fd, & rootInodeData, sizeof(inode));
-    current_inode = rootInodeData;
-
-}
-
-//Write data into Directory Data Block
-int writeDirBlock(int fd, void * data, inode * i_node) 
-{
-	unsigned short freeBlockNo = 0;
-	int i = 0;
-	if (i_node->addr[0] > 0)
-	{
-		freeBlockNo = i_node->addr[0];
-	}
-	else 
-	{
-		freeBlockNo = getFreeBlockk();
-	}
-
-	while (!(freeBlockNo == 0) && (writeBlock(fd, data, freeBlockNo * 512, 1) < 0) && i < 8)
-	{
-		i++;
-		if (i_node->addr[i] > 0) 
-		{
-			freeBlockNo = i_node->addr[i];
-		}
-		else 
-		{
-			freeBlockNo = getFreeBlockk();
-		}
-	}
-	if (freeBlockNo != 0)
-	{
-		i_node->addr[i] = freeBlockNo;
-	}
-    else
-    {
-        return -1;
-    }
-    return 0;
-
-}
-
-//Sets the allocated bit for the given inode
-setAllocatedBitINode(inode * i_node)
-{
-	i_node->flags |= (1 << 15);
-}
-
-//Resets the allocated bit for the given inode
-resetAllocatedBitInode(inode * i_node) 
-{
-	i_node->flags &= ~(1 << 15);
-}
-
-//Sets the Largefile bit for the given inode
-setLargeFileBitINode(inode * i_node)
-{
-	i_node->flags |= (1 << 12);
-}
-
-//Resets the Largefile bit for the given inode
-resetLargeFileBitInode(inode * i_node)
-{
-	i_node->flags &= ~(1 << 12);
-}
-
-//Sets the filetype bits for the given inode
-setDirectoryTypeFile(inode * i_node)
-{
-	i_node->flags |= (1 << 14);
-	i_node->flags &= ~(1 << 13);
-}
-
-//Checks given inode is allcoated to any file or not
-int isAllocatedInode(inode * i_node) 
-{
-    return ((i_node->flags >> 15) & 1);
-}
-
-//Checks given file is small or large
-int isLargeFile(inode * i_node)
-{
-    return ((i_node->flags >> 12) & 1);
-}
-
-//Checks given inode is for file or directory
-int isDirectory(inode * i_node)
-{
-    return (((i_node->flags >> 14) & 1) & ~((i_node->flags >> 13) & 1));
-}
-
-//Get next available free inode
-int getFreeInode()
-{
-
-	int curpos = lseek(fd, 512 * 2, SEEK_SET);
-	int inode_no = 1;
-	int offset = 512 * 2;
-	inode node;
-	ssize_t nbytes;
-	while ((nbytes = read(fd, & node, sizeof(inode))) != -1 && isAllocatedInode( & node)) 
-	{
-		lseek(fd, offset + (32 * inode_no), SEEK_SET);
-		inode_no++;
-		//search for new inode
-	}
-	return inode_no;
-
-}
-
-//Sets all the fields in single and double indirect blocks to zero
-initializeToZero(unsigned short block)
-{
-    lseek(fd,block*512,SEEK_SET);
-    int size=0;
-    while ( size < 512)
-    {
-        unsigned short   temp =0;
-        write(fd, & temp, sizeof(temp));
-        size+=sizeof(temp);
-    }
-}
-
-//Write the addr[] of inode into single indirect block till single indirect blocks are available (ie) from addr[0] to addr[6]; 
-//Else try for double indirection
-int writetSingleIndirectBlock(inode * i_node, unsigned short indirectblock[], unsigned short freeBlockNo, int isFromDoubleIndirection) 
-{
-	int i = 0;
-	if (freeBlockNo == 0 && isFromDoubleIndirection == 0)
-	{
-		if (indirectblock[0] > 0) 
-		{
-			freeBlockNo = indirectblock[0];
-		} 
-		else 
-		{
-			freeBlockNo = getFreeBlockk();
-			if(freeBlockNo!=0)
-			    initializeToZero(freeBlockNo);
-			else
-			    return 0;
-		}
-	}
-
-
-	while (!(freeBlockNo == 0) && (writeBlock(fd, i_node, freeBlockNo * 512, 2) < 0) && i < 7)
-	{
-		if (isFromDoubleIndirection == 1)
-			return -1;
-		i++;
-
-		if (indirectblock[i] > 0 && i < 7) 
-		{
-			freeBlockNo = indirectblock[i];
-		} 
-		else if(i<7) 
-		{
-			freeBlockNo = getFreeBlockk();
-            
-			initializeToZero(freeBlockNo);
-		}
-	}
-
-	if (isFromDoubleIndirection == 1)
-			return 0;
-
-	if (freeBlockNo != 0 && i != 7) 
-	{
-		indirectblock[i] = freeBlockNo;
-	}
-
-	if (i == 7) 
-	{
-		doubleIndirection(i_node, indirectblock);
-	}
-
-	for (i = 0; i < 8; i++) 
-	{
-		i_node->addr[i] = 0;
-	}
-	return 0;
-}
-
-//Write addr[] of given inode into double indirect block
-doubleIndirection(inode * i_node, unsigned short indirectblock[])
-{
-	unsigned short freeBlockNo;
-	int i = 0, nofBlocks=0;
-	if (indirectblock[7] <= 0)
-	{
-	    int temp=0;
-	    temp=getFreeBlockk();
-	    if(temp!=0)
-	    {
-		    indirectblock[7] =temp;
-		    initializeToZero(indirectblock[7]);
-		}
-		else
-		{
-			return;
-		}
-	}
-	lseek(fd, indirectblock[7] * 512, SEEK_SET);
-	read(fd, & freeBlockNo, sizeof(freeBlockNo));
-	if (freeBlockNo > 0) 
-	{
-		while (writetSingleIndirectBlock(i_node, indirectblock, freeBlockNo, 1) < 0) 
-		{
-			i++;
-			nofBlocks++;
-			lseek(fd, (indirectblock[7] * 512) + (2 * i), SEEK_SET);
-			read(fd, & freeBlockNo, sizeof(freeBlockNo));
-			if (freeBlockNo <= 0) 
-			{
-				if(nofBlocks< 249)//For 32MB file size limit
-				{
-				    int temp=0;
-				    temp=getFreeBlockk();
-				    if(temp!=0)
-				    {
-					    freeBlockNo = temp;
-					    initializeToZero(freeBlockNo);
-					    lseek(fd, (indirectblock[7] * 512) + (2 * (i)), SEEK_SET);
-					    write(fd, & freeBlockNo, sizeof(freeBlockNo));
-					}
-					else
-					{
-					    return;
-					}
-				}
-				else
-				{
-					printf("Max file size 32 MB reached");
-					break;
-				}
-			}
-		}
-	}
-	else 
-	{
-        int temp=0;
-        temp=getFreeBlockk();
-        if(temp!=0)
-        {
-            freeBlockNo = temp;
-		    initializeToZero(freeBlockNo);
-		    lseek(fd, indirectblock[7] * 512, SEEK_SET);
-		    write(fd, & freeBlockNo, sizeof(freeBlockNo));
-		    while (writetSingleIndirectBlock(i_node, indirectblock, freeBlockNo, 1) < 0) 
-		    {
-			    i++;
-			    nofBlocks++;
-			    lseek(fd, (indirectblock[7] * 512) + (2 * (i)), SEEK_SET);
-			    read(fd, & freeBlockNo, sizeof(freeBlockNo));
-			    if (freeBlockNo <= 0) 
-			    {   
-			        if(nofBlocks< 249) //For 32MB file size limit
-                    {
-				        int temp=0;
-		                temp=getFreeBlockk();
-				        if(temp!=0)
-				        {	
-				            freeBlockNo =temp;
-				            initializeToZero(freeBlockNo);
-				            lseek(fd, (indirectblock[7] * 512) + (2 * (i)), SEEK_SET);
-				            write(fd, & freeBlockNo, sizeof(freeBlockNo));
-				        }
-				        else
-				        {
-					        return;
-				        }
-			        }
-		 		    else
-		            {
-		                printf("Max file size 32 MB reached");
-		                break;
-			        }
-			    }
-		    }   
-	    }
-	    else
-	    {
-		    return;
-	    }
-    }
-}
-
-//Write the given data into addr[] of inode until addr[] gets filled; 
-//Else write filled addr[] into single indirect block
-int writeToFile(char data[], inode * i_node, unsigned short indirectblock[])
-{
-    unsigned short freeBlockNo = 0;
-    int i = 0;
-	int isLargeBlock=0,isLargeWritten=0;
-	isLargeBlock=isLargeFile(i_node);
-    while (i_node->addr[i] > 0 && i_node->addr[i] != 65535 && i < 8)
-	{
-			i++;
-    }
-    if (i < 8)
-    {
-        freeBlockNo = getFreeBlockk();
-    } 
-    else
-	{
-	    isLargeWritten=1;
-		setLargeFileBitINode(i_node);
-		unsigned short s = 0;
-		writetSingleIndirectBlock(i_node, indirectblock, s, 0);
-		int p=writeToFile(data, i_node, indirectblock);
-		return p;
-    }
-    if (!(freeBlockNo == 0) && (writeBlock(fd, data, freeBlockNo * 512, 0) < 0))
-	{
-        printf(" WriteBlock Failed , Error occured while writing into V6FileSystem\n");
-    }
-    if (freeBlockNo != 0) 
-    {
-        i_node->addr[i] = freeBlockNo;
-    }
-    else
-    {
-        return -1;
-    }
-
-	if((isLargeBlock==1 && isLargeWritten!=0) )
-	{
-		unsigned short s = 0;
-        writetSingleIndirectBlock(i_node, indirectblock, s, 0);
-	}
-return 0;
-}
-
-//Copies the given source file into destination file in the V6filesystem
-copyin(char * source, char * dest)
-{
-    char token[1000];
-    char *temptoken;
-    strcpy(token,dest);
-	int isFile ;
-	isFile=isFileAlreadyExist(dest);
-	if (isFile > 0 ) 
-	{
-        setInode1asCurrent();
-        printf("File name already exist \n");
-	    return;
-	} 
-	else if (isFile == -2)
-	{
-        setInode1asCurrent();
-        printf("one of the Directory in the given path not exist \n");
-        return;
-	}
-	else
-	{
-	    temptoken=strtok(token,"/");
-		while(temptoken)
-		{
-		    dest=temptoken;
-		    temptoken=strtok(0,"/");
-	    }
-	}
-	int inodeNo = getFreeInode();
-	if (inodeNo > superblock.isize)
-	{
-		printf(" \n Inode limit reached, no more files or directory can be created \n ");
-		return;
-	}
-
-    writeFileNameinDir(inodeNo, dest);
-
-	lseek(fd, ((inodeNo - 1) * 32) + (512 * 2), SEEK_SET);
-	inode new_inode;
-	ssize_t nbytes = read(fd, & new_inode, sizeof(inode));
-	if (nbytes > 0)
-	{
-		int sourceFd = open(source, O_RDWR);
-		char buf[512];
-		unsigned short indirectblock[8] = {0,0,0,0,0,0,0,0};
-		setAllocatedBitINode( & new_inode);
-		int bytes = 512;
-        int isSuccess=0;
-		while (read(sourceFd, & buf, 512) > 0)
-		{
-		if(	(isSuccess=writeToFile(buf, & new_inode, indirectblock))<0)
-        {
-            printf(" cpin Failed\n");
-            break;
-            
-        }
-			bytes += 512;
-		}
-		if(isLargeFile(&new_inode)==1)
-		{
-		       unsigned short s = 0;
-		       writetSingleIndirectBlock(&new_inode, indirectblock, s, 0);
-
-			int i;
-			for(i=0;i<8;i++)
-			{
-				new_inode.addr[i]=indirectblock[i];
-			}
-		}
-        
-		lseek(fd, ((inodeNo - 1) * 32) + (512 * 2), SEEK_SET);
-		write(fd, & new_inode, sizeof(inode));
-        if(isSuccess==0)
-        {
-        readFileInodeAddr(inodeNo);
-        readDirInodeAddr(getCurrentDirectoryInodeNo());
-        printf(" Given File copied into V6FileSystem successfully \n");
-
-        }
-        else
-        {
-            printf("Given file is partially written into the Filesystem till free data block exists \n");
-
-        }
-        
-		setInode1asCurrent();
-	}
-}
-
-//Returns the inode number of given file
-int getInodeNumber(char *path)
-{
-    int i;
-	for(i=0;i<8;i++)
-	{
-		int curpos = lseek(fd, 512*current_inode.addr[i], SEEK_SET);
-		int size=0;
-		int count=0;
-		while(size <512 )
-		{
-			dir tempdir;
-			ssize_t bytes_read = read(fd, &tempdir, sizeof(dir));
-			count++;
-			if(bytes_read==16)
-			{
-				if(strcmp(tempdir.file_name,path)==0)
-				{
-				return tempdir.inode_no;
-				}
-			}
-			size += 16;
-		}
-	}
-    for (i = 0; i < 8; i++)
-    {
-        int curpos = lseek(fd, 512 * current_inode.addr[i], SEEK_SET);
-        int size = 0;
-        int count = 0;
-        while (size < 512)
-        {
-            dir tempdir;
-            ssize_t bytes_read = read(fd, & tempdir, sizeof(dir));
-            count++;
-            if (bytes_read == 16)
-            {
-                if (strcmp(tempdir.file_name, path) == 0 && tempdir.inode_no >0)
-                {
-                    return 1;
-                }
-            }
-            size += 16;
-        }
-    }
-    return 0;
-}
-
-//Return 1 if the file/directory exist in filesystem; else returns negative numbers
-int isFileAlreadyExist(char *fullPath)
-{
-    char* token;
-    char temptoken[1000];
-    int i=0,j=0;
-    strcpy(temptoken,fullPath);
-    token=strtok(temptoken,"/");
-
-    while(token)
-    {
-        token=strtok(0,"/");
-        i++;
-    }
-    token = strtok(fullPath,"/");
-    while(token && j < i)
-    {
-        if( j==i-1)
-        {
-            if(isDirAlreadyExist(token)==1)
-            {
-                printf(" exist \n");
-	            int inodeNumber= getInodeNumber(token);
-                return inodeNumber;
-            }
-            else
-            {
-                printf(" Given File  not exist \n");
-                return -1;
-            }
-        }
-        if (isDirAlreadyExist(token)==1)
-        {
-            int inodeNumber= getInodeNumber(token);
-            lseek(fd,((inodeNumber-1)*32)+(512*2),SEEK_SET);
-            read(fd,&current_inode,sizeof(inode));
-        }
-        else
-        {
-            printf("Directory %s not exist \n", token);
-            return -2;
-        }
-        token=strtok(0,"/");
-        j++;
-   }
-}
-//Creates the new directory inside V6filesystem
-mkdirV6(char * path)
-{
-    char* token;
-    char temptoken[1000];
-    int i=0,j=0;
-    strcpy(temptoken,path);
-    token=strtok(temptoken,"/");
-	
-	while(token)
-	{
-		token=strtok(0,"/");
-		i++;
-	}
-
-    token = strtok(path,"/");
-
-	while(token && j < i)
-	{
-		if( j==i-1)
-		{
-			if(isDirAlreadyExist(token)==1)
-			{
-				printf("Directory Already exist \n");
-				return;
-			}
-			else
-			{
-				break;
-			}
-		}
-		
-		if (isDirAlreadyExist(token)==1)
-		{
-			int inodeNumber= getInodeNumber(token);
-			lseek(fd,((inodeNumber-1)*32)+(512*2),SEEK_SET);
-			read(fd,&current_inode,sizeof(inode));
-		}
-		else
-		{
-			printf("Directory %s not exist \n", token);
-			return;
-		}
-		token=strtok(0,"/");
-		j++;
-	}
-	int inodeNo = getFreeInode();
-
-	if (inodeNo > superblock.isize)
-	{
-		printf(" \n Inode limit reached, no more files or directory can be created \n ");
-		return;
-	}
-
-	lseek(fd, ((inodeNo - 1) * 32) + (512 * 2), SEEK_SET);
-	inode new_inode;
-	ssize_t nbytes = read(fd, & new_inode, sizeof(inode));
-	if (nbytes > 0)
-	{
-		setAllocatedBitINode( & new_inode);
-
-		setDirectoryTypeFile( & new_inode);
-
-		dir dirData;
-		dirData.inode_no = inodeNo;
-		strcpy(dirData.file_name, ".");
-
-	if(	writeDirBlock(fd, & dirData, & new_inode)==-1)
-    {
-        printf( "  Given Directory not created \n");
-        resetAllocatedBitInode(& new_inode);
-        return;
-    }
-
-		dirData.inode_no = getCurrentDirectoryInodeNo();
-
-		strcpy(dirData.file_name, "..");
-
-		if(writeDirBlock(fd, & dirData, & new_inode)==-1)
-        {
-              printf( "  Given Directory not created \n");
-                return;
-        }
-
-		int curpos = lseek(fd, ((inodeNo - 1) * 32) + (512 * 2), SEEK_SET);
-
-		ssize_t bytes_read = write(fd, & new_inode, sizeof(inode));
-
-		writeFileNameinDir(inodeNo, token);
-
-		readDirInodeAddr(inodeNo);
-		readDirInodeAddr(getCurrentDirectoryInodeNo());
-		readDirInodeAddr(1);
-		setInode1asCurrent();
-        printf(" Given Directory created successfully \n");
-	}
-}
-
-//Returns current directory inode number
-int getCurrentDirectoryInodeNo()
-{
-	dir tempdir;
-	lseek(fd, 512 * current_inode.addr[0], SEEK_SET);
-	read(fd, & tempdir, sizeof(dir));
-	return tempdir.inode_no;
-}
-
-//Check given directory exists in file system
-int isDirAlreadyExist(char * path) 
-{
-	int i;
-	for (i = 0; i < 8; i++) 
-	{
-		int curpos = lseek(fd, 512 * current_inode.addr[i], SEEK_SET);
-		int size = 0;
-		int count = 0;
-		while (size < 512) 
-		{
-			dir tempdir;
-			ssize_t bytes_read = read(fd, & tempdir, sizeof(dir));
-			count++;
-			if (bytes_read == 16) 
-			{
-		        if (strcmp(tempdir.file_name, path) == 0 && tempdir.inode_no >0) 
-			    {
-					return 1;
-			    }
-			}
-			size += 16;
-		}
-	}
-	return 0;
-}
-
-//Write given filenames inside the directory data block
-writeFileNameinDir(int inode_no, char * path) 
-{
-	int i;
-	for (i = 0; i < 8; i++) 
-	{
-		int curpos = lseek(fd, 512 * current_inode.addr[i], SEEK_SET);
-		int size = 0;
-		int count = 0;
-		while (size < 512) 
-		{
-			dir tempdir;
-			ssize_t bytes_read = read(fd, & tempdir, sizeof(dir));
-			count++;
-			if (tempdir.inode_no == 0) 
-			{
-					tempdir.inode_no = inode_no;
-					strcpy(tempdir.file_name, path);
-					writeDirBlock(fd, & tempdir, & current_inode);
-					return;
-			}
-			size += 16;
-		}
-	}
-	return 0;
-}
-
-//Sets root node as current inode
-setInode1asCurrent()
-{
-    int curpos = lseek(fd, 512*2, SEEK_SET);
-    ssize_t bytes_read = read(fd, &current_inode, sizeof(inode));
-}
-
-//Read existing initiazlised V6filesystem file
-readV6FS() 
-{
-	fd = open("V6FileSystem", O_RDWR);
-	int curpos = lseek(fd, 512 * 2, SEEK_SET);
-	ssize_t bytes_read = read(fd, & current_inode, sizeof(inode));
-	if (!isAllocatedInode( & current_inode)) 
-	{
-		printf("V6FileSystem not initialized \n");
-		return;
-	}
-	curpos = lseek(fd, 512 * 1, SEEK_SET);
-	bytes_read = read(fd, & superblock, sizeof(super_block));
-}
-
-void main() 
-{
-    
-    char input[MAX];
-    char* commandsArgv[256];
-    int res;
-    while(1)
-    {
-        // Printing command prompt
-        printf(">>");
-        // Gets user input
-        if(fgets(input,sizeof(input),stdin))
-        {
-            char* s;
-            int spaceCharIndex = strlen(input)-1;
-            int j=0;
-            input[spaceCharIndex]='\0';
-            commandsArgv[j] = strtok(input, " " );
-
-            while( commandsArgv[j]!=NULL)
-            {
-                commandsArgv[++j]=strtok(NULL, " " );
-            }
- 
-            if(commandsArgv[0]!=NULL)
-            {
-            // if user enters 'q', comeout of loop
-            res = strcmp(input,"q");
-            if (res == 0)
-            {
-                printf("Exiting from file system... \n");
-                break;
-            }
-            else
-            {
-                if(!strcmp(commandsArgv[0],"initfs"))
-                {
-                    printf("Initiating File System \n");
-                    initializeFS(atoi(commandsArgv[1]), atoi(commandsArgv[2]));
-                }
-                else if(!strcmp(commandsArgv[0],"cpin"))
-                {
-                    printf("Copying external file into filesystem \n");
-                    readV6FS();
-                    copyin(commandsArgv[1], commandsArgv[2]);
-                }
-                else if(!strcmp(commandsArgv[0],"cpout"))
-                {
-                    printf("Copying out a file from filesystem \n");
-                    readV6FS();
-                    copyout(commandsArgv[1], commandsArgv[2]);
-                }
-                else if(!strcmp(commandsArgv[0],"mkdir"))
-                {
-                    printf("Creating directory inside file system \n");
-                    readV6FS();
-                    mkdirV6(commandsArgv[1]);
-                }
-                else if(!strcmp(commandsArgv[0],"rm"))
-                {
-                    printf("Deleting a file from filesystem \n");
-                    readV6FS();
-                    removeFileDir(commandsArgv[1]);
-
-                }
-                else
-                {
-                    printf("Please enter valid input \n");
-                    printf("Below are options:\n");
-                    printf("    initfs <fsize> <total_num_of_inodes> \n");
-                    printf("    cpin <external_sourceFilePath> <destination_path>\n");
-                    printf("    cpout <internal_sourceFilePath> <external_destPath>\n");
-                    printf("    mkdir <DirectoryPath>\n");
-                    printf("    rm <FilePath>     \n");
-                    printf("Or type q to exit \n");
-                }
-                }
-            }
-        }
-    }
-}
-
-//Reads directory data block of given directory inode
-readDirInodeAddr(int inode_number) 
-{
-    printf(" Displaying the contents of Directory with I_node no %d \n",inode_number);
-	int i;
-	int curpos = lseek(fd, ((inode_number - 1) * 32) + (512 * 2), SEEK_SET);
-	inode node;
-	ssize_t bytes_read = read(fd, & node, sizeof(inode));
-	printf(" /n -- Inode no %d --/n", inode_number);
-	printf(" inode flags isDirec %d , isAlloc %d , isLarge %d ", isAllocatedInode( & node), isDirectory( & node), isLargeFile( & node));
-	printf("/n Address array");
-	for (i = 0; i < 8; i++) 
-	{
-		printf(" \n array[%d] is %d \n", i, node.addr[i]);
-		curpos = lseek(fd, 512 * node.addr[i], SEEK_SET);
-		int size = 0;
-		int count = 0;
-		while (size < 512 && i == 0) 
-		{
-			dir tempdir;
-			bytes_read = read(fd, & tempdir, sizeof(dir));
-			count++;
-			if (bytes_read == 16)
-					printf(" bytes read %d ,  Directory inode_no %d , file name is %s \n ", bytes_read, tempdir.inode_no, tempdir.file_name);
-			size += 16;
-		}
-		printf(" No of dir %d \n", count);
-	}
-}
-
-//Reads content of given inode
-readFileInodeAddr(int inode_number)
-{
-    int i;
-    int curpos = lseek(fd, ((inode_number - 1) * 32) + (512 * 2), SEEK_SET);
-    inode node;
-    ssize_t bytes_read = read(fd, & node, sizeof(inode));
-    printf(" /n -- Inode no %d --/n", inode_number);
-    printf(" inode flags isDirec %d , isAlloc %d , isLarge %d ", isAllocatedInode( & node), isDirectory( & node), isLargeFile( & node));
-    printf("/n Address array");
-    for (i = 0; i < 8; i++)
-    {
-        printf(" \n array[%d] is %d \n", i, node.addr[i]);
-    }
-}
-
-//Initializes super block of V6FileSystem
-initializeSuperBlock(int totalBlocks, int no_of_Inodes)
-{
-	initializeInode(no_of_Inodes);
-	int no_Of_Inodes_Blocks = no_of_Inodes / 16;
-	if (no_of_Inodes % 16 > 0) 
-	{
-		no_Of_Inodes_Blocks++;
-	}
-	int freeNodeStartPoint = no_Of_Inodes_Blocks + 2;
-	initializeFreeBlock(totalBlocks, freeNodeStartPoint, 1);
-	superblock.nfree--;
-
-	superblock.isize = no_of_Inodes;
-	int curpos = lseek(fd, 512, SEEK_SET);
-	write(fd, & superblock, sizeof(superblock));
-}
-//Initialize the given number of inodes in the V6 filesystem
-initializeInode(int no_of_Inodes)
-{
-	int offset = 512 * 2;
-	int curpos = lseek(fd, offset, SEEK_SET);
-	int i;
-	no_of_Inodes++;
-	while (no_of_Inodes) 
-	{
-		inode inodeData = {0};
-		for (i = 0; i < 8; i++)
-		{
-		    inodeData.addr[i] = 0;
-	    }
-		write(fd, & inodeData, sizeof(inode));
-		no_of_Inodes--;
-		curpos = lseek(fd, 0, SEEK_CUR);
-	}
-}
-//Initialize free list of the V6filesystem 
-initializeFreeBlock(int totalBlocks, int freeNodeStartPoint, int isFirstBlock) 
-{
-	int i;
-	int curpos = lseek(fd, 0, SEEK_CUR);
-	if (isFirstBlock)
-    {
-		superblock.nfree = 1;
-		superblock.free[0] = 0;
-	} 
-	while (freeNodeStartPoint < totalBlocks) 
-	{
-		while (superblock.nfree != 100 && freeNodeStartPoint < totalBlocks) 
-		{
-			superblock.free[superblock.nfree] = freeNodeStartPoint;
-			superblock.nfree++;
-			freeNodeStartPoint++;
-		}
-		int curpos = lseek(fd, freeNodeStartPoint * 512, SEEK_SET);
-		if (freeNodeStartPoint < totalBlocks)
-		{
-            superblock.nfree--;
-			write(fd, & superblock.nfree, sizeof(superblock.nfree));
-			for (i = 0; i <=superblock.nfree; i++) 
-			{
-			write(fd, & superblock.free[i], sizeof(superblock.free[i]));
-			}
-			superblock.nfree = 0;
-		}
-	}
-}
-//Writes the data block depends on the isDir values
-//if isDir = 1, write the given data as a directory content
-//else if isDir=2, writes the given addresses into single/double indirect block
-//else, writes it as a plain file 512 bytes
-int writeBlock(int fd, void * data, int offset, int isDir) 
-{
-	unsigned int size = 0;
-	int curpos = lseek(fd, offset, SEEK_SET);
-	if (curpos == offset && isDir == 1) 
-	{
-		dir temp;
-		ssize_t nbytesRead;
-		while ((nbytesRead = read(fd, & temp, sizeof(dir))) > 0 && size < 512) 
-		{
-			if (temp.inode_no > 0) 
-			{
-				size += sizeof(dir);
-			} 
-			else 
-			{
-				break;
-			}
-		}
-		if (size < 512) 
-		{
-			lseek(fd, -nbytesRead, SEEK_CUR);
-			write(fd, data, sizeof(dir));
-
-		} 
-		else 
-		{
-			return -1;
-		}
-	} 
-	else if (isDir == 2) 
-	{
-		unsigned short temp;
-		ssize_t nbytes;
-		int i=0;
-		while (((nbytes = read(fd, & temp, sizeof(temp))) > 0) && temp > 0 && size < 512) 
-		{i++;
-			size += sizeof(temp);
-		}
-		if (size < 512) 
-		{	
-			lseek(fd, -nbytes, SEEK_CUR);
-			int i;
-			for (i = 0; i < 8; i++) 
-			{
-				temp = ((struct inode * ) data)->addr[i];
-				if(temp >0 )
-				write(fd, & temp, sizeof(temp));
-			}
-		} 
-		else 
-		{
-			return -1;
-		}
-	} 
-	else 
-	{
-	    int i;
-	    char buf[512];
-        strncpy(buf,data, 512);
-		ssize_t nbytes = write(fd, buf, sizeof(char)*512);
-	}
-	return 1;
-}
-
-//Add given free block into freelist
-addFreeBlocks(unsigned short freeBlockNo)
-{
-    int i;
-    off_t addr;
-    addr=lseek(fd, 0, SEEK_CUR);
-    if (superblock.nfree != 100 )
-    { 
-	    superblock.nfree++;
-        superblock.free[superblock.nfree] = freeBlockNo;
-	    lseek(fd, 512, SEEK_SET);
-	    write(fd, & superblock, sizeof(super_block));
-        lseek(fd, addr, SEEK_SET);
-    }
-    else
-    {
-        int curpos = lseek(fd, freeBlockNo * 512, SEEK_SET);
-        write(fd, & superblock.nfree, sizeof(superblock.nfree));
-        for (i = 0; i <= superblock.nfree; i++)
-        {
-            write(fd, & superblock.free[i], sizeof(superblock.free[i]));
-        }
-        superblock.nfree = 0;
-        superblock.free[superblock.nfree]=freeBlockNo;
-        lseek(fd, addr, SEEK_SET);
-   }
-}
-
-//Frees all 256 addresses of single indirect block and also given block; And add them into free list 
-removeBlock(unsigned short  blockNo)
-{
-
-   unsigned short temp,size=0;
-   ssize_t nbytes;
-   lseek(fd, blockNo*512, SEEK_SET);
-   int i=0;
-   while (((nbytes = read(fd, & temp, sizeof(temp))) > 0) && temp > 0 && size < 512)
-    {
-	addFreeBlocks(temp);
-	
-               size += sizeof(temp);
-	       i++;
-         }
-	 addFreeBlocks(blockNo);
-}
-
-//Frees all 256 addresses of double indirect block and add it into free list
-removeDoubleIndirect(inode *i_node)
-{
-    unsigned short temp,size=0;
-    off_t addr;
-    ssize_t nbytes;
-	if(i_node->addr[7]>0 && i_node->addr[7] != 65535 )
-	{
-	     lseek(fd, i_node->addr[7]*512, SEEK_SET);
-	    while (((nbytes = read(fd, & temp, sizeof(temp))) > 0) && temp > 0 && temp!= 65535  && size < 512)
-	    {
-
-	        addr=lseek(fd, 0, SEEK_CUR);
-            removeBlock(temp);
-	        size += sizeof(temp);
-	        lseek(fd, addr, SEEK_SET);
-	    }
-         addFreeBlocks(i_node->addr[7]);
-	}	
-}
-
-//Deletion of large file
-removeLargeFie(inode * i_node)
-{
-    int i = 6;
-    removeDoubleIndirect(i_node);
-    while (i!=-1 && i_node->addr[i]>0 && i_node->addr[i] != 65535 )
-    {
-	    removeBlock(i_node->addr[i]);
-        i--;
-    }
-    resetLargeFileBitInode(i_node);
-}
-
-//Removes file name entry from the directory data block
-removeFileNameinDir(int inode_no)
-{
-        int i;
-        for (i = 0; i < 8; i++)
-        {
-              int curpos = lseek(fd, 512 * current_inode.addr[i], SEEK_SET);
-              int size = 0;
-           int count = 0;
-              while (size < 512)
-             {
-                 dir tempdir;
-                ssize_t bytes_read = read(fd, & tempdir, sizeof(dir));
-                  count++;
-                 if (tempdir.inode_no == inode_no)
-                    {
-                       tempdir.inode_no = 0;
-		       strcpy(tempdir.file_name,"");
-		        lseek(fd,-bytes_read, SEEK_CUR);
-			 write(fd, &tempdir, sizeof(dir));
-                      return;
-                    }
-                size += 16;
-             }
-      }
-    return 0;
-}
-
-//Removes file from v6filesystem of given inode
-rmfile(  inode *i_node)
-{
-    int i=0;
-	if(isLargeFile(i_node)==1)
-	{	
-		removeLargeFie(i_node);
-	}	
-	else
-	{
-  		while(i_node->addr[i] > 0 && i_node->addr[i] != 65535 && i<8)
-		{		
-			addFreeBlocks(i_node->addr[i]);
-			i++;
-		}
-	}
-    resetAllocatedBitInode(i_node);
-        for(i=0;i<8;i++)
-        {
-            i_node->addr[i] =0;
-        }
-}
-
-//Removes the given file from v6filesystem using given file path
-removeFileDir(char * path)
-{
-    inode new_inode;
-    int i_node_no;
-    i_node_no=isFileAlreadyExist(path);
-	if(i_node_no>0)
-	{
-		 lseek(fd, ((i_node_no - 1) * 32) + (512 * 2), SEEK_SET);
-		 ssize_t nbytes = read(fd, & new_inode, sizeof(inode));
-		 if(isDirectory(&new_inode))
-		 {
-		 	printf("Given file is the directory, only file remove is allowed \n");
-			
-		 }
-		 else
-		 {
-		 	rmfile(&new_inode);
-			removeFileNameinDir(i_node_no);
-          int curpos = lseek(fd, ((i_node_no - 1) * 32) + (512 * 2), SEEK_SET);
-
-        ssize_t bytes_read = write(fd, & new_inode, sizeof(inode));
-
-			readDirInodeAddr(getCurrentDirectoryInodeNo());
-			setInode1asCurrent();
-        }
-        printf("Given file removed from the V6FileSystem successfully \n");
-	}
-	else
-	{
-		printf("Given file or directory not exist %s \n",path);
-	}
-}
-/**************************************************************************************
-*This function returns whole inode structure when inode number is given as an argument
- **************************************************************************************/
-inode getInodeInfoFromInodeNum(int inode_no)
-{
-    lseek(fd, ((inode_no - 1) * 32) + (512 * 2), SEEK_SET);
-    inode new_inode;
-    ssize_t nbytes = read(fd, & new_inode, sizeof(inode));
-    return new_inode;
-}
-
-/********************************************************************************************
- * This function Reads 512 bytes of v6filesystem from given offset and write into output file 
- *********************************************************************************************/
-readOneBlockAndWriteIntoFile(int fd, int offset, int fd_outputFile)
-{
-    int curpos = lseek(fd, offset, SEEK_SET);
-    char cbuf[512];
-    int nbytes= read(fd,cbuf,511);
-    //printf("Data  %s  \n",cbuf);
-    int count = write(fd_outputFile,cbuf,512);
-}
-/**************************************************************************************
-* For small file - Gets file's inode as input & copies the file content to output file
-* *************************************************************************************/
-copyoutSmallFile(int fd_outputFile, inode * inputFileinode)
-{
-    int i;
-    for(i=0;i<8;i++)
-    {
-        if((inputFileinode->addr[i]!=0)&&(inputFileinode->addr[i]!=65535))
-        {
-            int offset = (inputFileinode->addr[i])*512;
-            readOneBlockAndWriteIntoFile(fd,offset,fd_outputFile);
-        }
-    }
-         printf("File copied completely \n");
-}
-/**************************************************************************************
-* For Large file - Gets file's inode as input & copies the file content to output file
-* *************************************************************************************/
-copyoutLargeFile(int fd_outputFile, inode * inputFileinode)
-{
-    int i,j,k;
-    for(i=0;i<8;i++)
-    {
-        //Handling single indirect block
-        if(inputFileinode->addr[i]!=0 && (i<7) &&(inputFileinode->addr[i]!=65535) )
-        {
-            unsigned short nextDataBlockAddr=0;
-            int offset = (inputFileinode->addr[i])*512;
-            for(j=0;j<256;j++)
-            {
-                int curpos = lseek(fd, offset, SEEK_SET);
-                read(fd,&nextDataBlockAddr,sizeof(nextDataBlockAddr));
-                if(nextDataBlockAddr!=0&&nextDataBlockAddr!=65535)
-                {
-                    readOneBlockAndWriteIntoFile(fd,(nextDataBlockAddr*512),fd_outputFile);
-                    offset=offset+sizeof(nextDataBlockAddr);
-                }
-                else
-                {
-                    printf("File copied completely \n");
-                    break;
-                }
-            }
-            if(nextDataBlockAddr==0 || nextDataBlockAddr==65535)
-            {
-                printf("cpout involving single indirect block completed successfully \n");
-                break;
-            }
-        }
-        //Handling double indirect block
-        else if(inputFileinode->addr[i]!=0 && i==7&&(inputFileinode->addr[i]!=65535))
-        {
-            int first_offset = (inputFileinode->addr[i])*512;
-            if(first_offset!=0)
-            {
-            for(j=0;j<256;j++)
-            {
-                unsigned short secondIndirectBlockAddr=0;
-                int curpos = lseek(fd, first_offset, SEEK_SET);
-                read(fd,&secondIndirectBlockAddr,sizeof(secondIndirectBlockAddr));
-                int second_offset = (secondIndirectBlockAddr*512);
-                for(k=0;k<256;k++)
-                {
-                    if(secondIndirectBlockAddr!=0 && secondIndirectBlockAddr!=65535)
-                    {
-                        readOneBlockAndWriteIntoFile(fd,(secondIndirectBlockAddr*512),fd_outputFile);
-                        second_offset=second_offset+sizeof(secondIndirectBlockAddr);
-                        curpos = lseek(fd, second_offset, SEEK_SET);
-                        read(fd,&secondIndirectBlockAddr,sizeof(secondIndirectBlockAddr)); 
-                    }
-                    else
-                    {
-                        printf("File copied completely \n");
-                        break;
-                    }
-                }
-                first_offset=first_offset+sizeof(secondIndirectBlockAddr);
-                if((secondIndirectBlockAddr==0) || (secondIndirectBlockAddr==65535))
-                {
-                    printf("cpout involving double indirect block completed successfully \n");
-                    break;
-                }
-            }
-            }
-        }
-    }
-}
-
-/**************************************************************************************
-* Copies source file from fileSystem to external path
-* *************************************************************************************/
-copyout(char * source, char * dest)
-{
-    printf("cpout %s , %s", source, dest);
-    int fd_outputFile;
-    int sourceFileiNodeNum=isFileAlreadyExist(source);
-    if (sourceFileiNodeNum != -1) //Check source file exist in file system
-    {
-        printf("Source directory exist in the file system. Proceeding..\n");
-        fd_outputFile = open(dest, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
-        inode new_node;
-        new_node = getInodeInfoFromInodeNum(sourceFileiNodeNum);
-        //check file is small or big
-        if(isLargeFile(&new_node)==0)
-        {
-            printf("source is a small file \n");
-            copyoutSmallFile(fd_outputFile,&new_node);
-        }
-        else
-        {
-            printf("Source file is large \n");
-            copyoutLargeFile(fd_outputFile,&new_node);
-        }
-    }
-    else
-    {
-        printf("Source directory doesnt exist in the file system. Cannot proceed..\n");
-    }
-}
-
+/********************************************************************************************************************************************************
+ *
+ * File Name: fsaccess.c
+ *
+ * How to execute this file:
+ * 	gcc -o output_file_name fsaccess.c -pthread
+ * 	gcc -c -DV6FS_LIBRARY fsaccess.c	(builds the library of v6fs.h, without the prompt)
+ *  	./output_file_name
+ *  	./output_file_name -m		(accesses V6FileSystem through a memory mapping of the whole image)
+ *  	./output_file_name -s		(uses plain pread/pwrite instead of io_uring for V6FileSystem)
+ *  	./output_file_name -g		(group commit: with a journal, commands share one commit until sync or q)
+ *  	./output_file_name -f script	(batch mode: runs the commands of script, or of stdin for -, one status line each)
+ *  		This will give a prompt ">>"
+ * 		What inputs to be given:
+ *   		initfs <fsize> <total_num_of_inodes> [bitmap] [journal] [wide [block_size]]
+ *   		cpin <external_sourceFilePath> <destination_path>
+ *   		cpout <internal_sourceFilePath> <external_destPath>
+ *   		cpin-many <destination_directory> <external_sourceFile_or_pattern> ...
+ *   		cpout-many <internal_sourceDirectory> <external_destDirectory>
+ *   		read <FilePath> <offset> <length>
+ *   		cat <FilePath>
+ *   		mkdir <DirectoryPath>
+ *   		rm <FilePath>
+ *   		rm -r <FileOrDirectoryPath>
+ *   		df
+ *   		sync
+ *   		Type q to exit
+ * Description:
+ *  Implementation of Unix V6 filesystem
+ *
+ * Authors:
+ *  Name                    
+ *  Kavitha Rajendran       
+ *  Rajkumar Panneer Selvam   
+ *
+*********************************************************************************************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h> 
+#include <fcntl.h> 
+#include <sys/stat.h> 
+#include <string.h> 
+#include <stdlib.h> 
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <glob.h>
+#include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include <stdarg.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "v6fs.h"
+//io_uring is built in when the system headers know the syscall and the IORING_OP_READ/WRITE opcodes (the same
+//headers added IORING_FEAT_RW_CUR_POS); otherwise only the pread/pwrite engine exists
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_RW_CUR_POS)
+#define HAVE_IO_URING
+#endif
+#define MAX 1024
+#define V6_BLOCK_SIZE 512
+#define MIN_WIDE_BLOCK_SIZE 1024
+#define MAX_BLOCK_SIZE 65536
+#define WIDE_BLOCK_SIZE 4096
+#define WIDE_MAGIC 0x45444957
+#define MAX_WIDE_BLOCKS 0x40000000
+#define MAX_INDIRECT_ENTRIES (MAX_BLOCK_SIZE / sizeof(unsigned int))
+#define NBUF 128
+#define BUF_HASH 64
+#define MAX_BLOCKS 65536
+#define FREE_WINDOW 100
+#define GROUP_BLOCKS (V6_BLOCK_SIZE * 8)
+#define DATA_RUN_BYTES 65536
+#define DATA_RUN_SLOTS 4
+#define IO_QUEUE_DEPTH 64
+#define IO_SUBMIT_BATCH 16
+#define PREFETCH_AHEAD 8
+#define PIPE_SLOTS 16
+#define PIPE_CHUNK DATA_RUN_BYTES
+#define MAX_WORKERS 64
+#define MAX_DOUBLE_ENTRIES 249
+#define DIR_INDEX_HASH 256
+#define DIR_HASH_MAGIC 0x4844
+#define DIR_HASH_BUCKETS 16
+#define PATH_CACHE_HASH 1024
+#define PATH_CACHE_MAX 8192
+#define JOURNAL_BLOCKS 1024
+#define JOURNAL_MAGIC 0x4c4a3656
+#define JOURNAL_HEADER 1
+#define JOURNAL_DESCRIPTOR 2
+#define JOURNAL_REVOKE 3
+#define JOURNAL_COMMIT 4
+#define JOURNAL_ENTRIES ((V6_BLOCK_SIZE - 16) / sizeof(unsigned short))
+
+//SuperBlock Structure; beyond the V6 fields, bitmap is the first block of the on-disk free-block bitmap
+//(0 when the free blocks are kept in the V6 free chain) and journal/journalSize the area of the metadata
+//journal (0 when V6FileSystem has none)
+//A wide V6FileSystem (initfs ... wide) has wideMagic set and keeps its geometry in the 32 bit fields after it;
+//fsize, bitmap and journal are 0 there
+typedef struct super_block
+{
+    unsigned short isize;
+    unsigned short fsize;
+    unsigned short nfree;
+    unsigned short free[100];
+    unsigned short ninode;
+    unsigned short inode[100];
+    char flock;
+    char ilock;
+    char fmod;
+    unsigned short time[2];
+    unsigned short bitmap;
+    unsigned short journal;
+    unsigned short journalSize;
+    unsigned int wideMagic;
+    unsigned int blockSize;
+    unsigned int blocks;
+    unsigned int bitmapBlock;
+    unsigned int journalBlock;
+}super_block;
+
+//Inode structure as kept in memory; readInode() and writeInode() convert it from and into the on-disk inode
+//of the format. size holds the size of a file of a wide V6FileSystem, size0/size1 that of a V6 one
+typedef struct inode 
+{
+    unsigned short flags;
+    char nlinks;
+    char uid;
+    char gid;
+    char size0;
+    unsigned short size1;
+    unsigned int addr[8];
+    unsigned short actime[2];
+    unsigned short modtime[2];
+    off_t size;
+}inode;
+
+//On-disk inode of the V6 format, 32 bytes
+typedef struct v6Inode
+{
+    unsigned short flags;
+    char nlinks;
+    char uid;
+    char gid;
+    char size0;
+    unsigned short size1;
+    unsigned short addr[8];
+    unsigned short actime[2];
+    unsigned short modtime[2];
+}v6Inode;
+
+//On-disk inode of a wide V6FileSystem, 64 bytes: 32 bit block numbers and a 64 bit size
+typedef struct wideInode
+{
+    unsigned short flags;
+    char nlinks;
+    char uid;
+    char gid;
+    char unused[3];
+    unsigned long long size;
+    unsigned int addr[8];
+    unsigned short actime[2];
+    unsigned short modtime[2];
+    char spare[8];
+}wideInode;
+
+//One entry in a data block if file type is directory; First 2 bytes --> File inode number; remaining 16 bytes --> Filename
+typedef struct dir 
+{
+    unsigned short inode_no;
+    char file_name[14];
+}dir;
+
+//Header of a hashed directory, kept in the entry slot after . and .. in its first block; inode_no is 0
+//so that the header reads as an unused entry. count is the number of entries in the buckets
+typedef struct dirHashHeader
+{
+    unsigned short inode_no;
+    unsigned short magic;
+    unsigned int buckets;
+    unsigned int count;
+    unsigned int unused;
+}dirHashHeader;
+
+//File descriptor of V6FileSystem; once imageOpen is set the image stays open for the rest of the session
+//imageFile is the image file, V6FileSystem for the fsaccess prompt
+static int fd;
+static int imageOpen;
+static char imageFile[1000] = "V6FileSystem";
+
+//Batch mode (fsaccess -f): commands come from a script without prompts, progress messages or directory dumps
+//and each command reports one status line; commandDone is set by a command that completed
+//Set as well for programs using the library interface (v6fs.h); the fsaccess prompt clears it
+static int batchMode = 1;
+static int commandDone;
+
+static super_block superblock = {0};
+
+//Geometry of the open V6FileSystem, set by setGeometry() from its super block: the V6 format has 512 byte blocks,
+//16 bit block numbers and 32 byte inodes, a wide V6FileSystem blocks of 1K to 64K, 32 bit block numbers and 64 byte inodes
+//Indirect blocks and journal records hold addrSize byte block numbers; one bitmap block covers an allocation group
+static int wideFormat;
+static int blockSize = V6_BLOCK_SIZE;
+static int addrSize = sizeof(unsigned short);
+static int inodeSize = sizeof(v6Inode);
+static int inodesPerBlock = V6_BLOCK_SIZE / sizeof(v6Inode);
+static int indirectEntries = V6_BLOCK_SIZE / sizeof(unsigned short);
+static int doubleIndirectEntries = MAX_DOUBLE_ENTRIES;
+//A large file has single indirect blocks in addr[0] to addr[singleSlots - 1] and its double indirect block in
+//addr[singleSlots]; a wide V6FileSystem has 6 single slots and a triple indirect block in addr[7] (tripleIndirect)
+//maxFileBlocks is the number of logical blocks a file can have
+static int singleSlots = 7;
+static int tripleIndirect;
+static int maxFileBlocks = (7 + MAX_DOUBLE_ENTRIES) * (V6_BLOCK_SIZE / sizeof(unsigned short));
+static int groupBlocks = GROUP_BLOCKS;
+static int journalEntries = JOURNAL_ENTRIES;
+static unsigned int fsBlocks;
+static unsigned int bitmapStart;
+static unsigned int journalStart;
+//Current directory is per thread, so that bulk copy workers can each work in their own directory
+static __thread inode current_inode;
+static __thread int current_inode_no = 1;
+
+//Free-inode bitmap, one bit per inode; built once when V6FileSystem is opened
+static unsigned long long *inodeBitmap;
+static int inodeBitmapWords;
+static int inodeSearchStart;
+
+//Free-block bitmap, one bit per block (set = in use) of whole allocation groups; built from the free chain when
+//V6FileSystem is opened and written back as the free chain by syncFreeChain()
+//The free chain windows only exist in the V6 format, whose block numbers are below MAX_BLOCKS
+static unsigned long long *blockBitmap;
+static int blockBitmapWords;
+static int blockBitmapDirty;
+static int blockBitmapBuilt;
+static int chainInWindowFormat;
+static char freeWindowDirty[MAX_BLOCKS / FREE_WINDOW + 1];
+static unsigned short windowHolder[MAX_BLOCKS / FREE_WINDOW + 1];
+
+//Allocation group: a groupBlocks slice of the free-block bitmap with its own free count, search start and lock;
+//the bits of a group are only changed under its lock, so threads allocating in different groups never contend
+typedef struct allocGroup
+{
+    pthread_mutex_t lock;
+    int freeCount;
+    int searchStart;
+    int bitmapDirty;
+}allocGroup;
+
+static allocGroup *allocGroups;
+static int allocGroupCount;
+static int allocGroupsInitialized;
+
+//Blocks freed by the current rm; flushFreedBlocks() gives them back to the free-block bitmap in one sorted pass
+static unsigned int *freedBlocks;
+static int freedBlockCount;
+static int freedBlockCapacity;
+
+//Group the allocations of this thread start in: the group of the directory the file being written lives in
+static __thread int allocGroupHint;
+
+//Pending run of consecutive file data blocks of the file this thread writes; a full run is written
+//in the background while the next slot fills
+static __thread char dataRunBuf[DATA_RUN_SLOTS][DATA_RUN_BYTES];
+static __thread int dataRunPending[DATA_RUN_SLOTS];
+static __thread int dataRunSlot;
+static __thread unsigned int dataRunStart;
+static __thread int dataRunCount;
+
+//One block of V6FileSystem held in the buffer cache; storage holds blockSize bytes
+typedef struct buffer
+{
+    unsigned int blockNo;
+    int isValid;
+    int isDirty;
+    int refCount;
+    int ioPending;
+    struct buffer *lruPrev;
+    struct buffer *lruNext;
+    struct buffer *hashNext;
+    char *data;
+    char *storage;
+}buffer;
+
+//Buffer cache: buffers are kept in LRU order (head is most recently used) and hashed on block number
+//cacheLock guards the buffer cache and the I/O engine; it is recursive as cache functions call each other
+static pthread_mutex_t cacheLock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static buffer bufferPool[NBUF];
+static int bufferCount;
+static buffer *bufferHash[BUF_HASH];
+static buffer *lruHead;
+static buffer *lruTail;
+static int bufferStorageSize;
+
+//Metadata journal (initfs ... journal): blocks modified through the buffer cache stay there until commitJournal()
+//logs them as one transaction into the journal area of V6FileSystem - descriptor records listing the block numbers,
+//each followed by the images of its blocks, revoke records for freed blocks and a commit record holding a checksum
+//of the transaction - made durable with one fdatasync. The home blocks are written by checkpointJournal() when
+//the journal fills up, on sync and on exit; until then committed blocks are read back from the journal
+//A transaction larger than the journal writes the blocks it allocated home first; if the rest still does not fit,
+//it is dropped and the command fails, so no other block is ever written home before its commit. rm -r and cpin-many
+//commit at safe points between files (journalSafePoint()) so that they never grow that large
+//Slot 0 of the journal is the header: sequence number of the first transaction replayJournal() applies
+//A record fills one block; blocks holds journalEntries block numbers of addrSize bytes
+typedef struct journalRecord
+{
+    unsigned int magic;
+    unsigned short type;
+    unsigned short count;
+    unsigned int sequence;
+    unsigned int checksum;
+    unsigned char blocks[];
+}journalRecord;
+
+static int journalActive;
+static int journalOpened;
+static int groupCommit;
+static unsigned int journalSequence;
+static int journalTail;
+//Journal slot holding the newest committed image of each block, 0 when the home block is current
+static unsigned short *journalSlotOf;
+//Blocks freed in the open transaction while an image of them is in the journal
+static char *journalRevoked;
+static int journalRevokeCount;
+//Blocks allocated in the open transaction; nothing committed refers to them, so they may be written home before it commits
+static char *journalFresh;
+static int journalHomeWrites;
+//Number of transactions committed, and set when the open transaction was dropped by abortJournal()
+static unsigned int journalCommits;
+static int journalDropped;
+//cpin-many workers hold it for reading while they copy a file; journalSafePoint() takes it for writing to commit
+static pthread_rwlock_t transactionLock = PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP;
+
+//Functions used before they are defined
+static int journalCanGrowCache();
+static int writeBackFreshBuffers();
+static checkpointJournal();
+static syncSuperBlock();
+static readFreeChain();
+static buildAllocGroups();
+static syncFreeChain();
+static flushDataRun();
+static report(const char * format, ...);
+static progress(char * message);
+static setGeometry(int wide, int size);
+static readInode(int inode_no, inode * node);
+static initializeRootInode();
+static int writeDirBlock(void * data, inode * i_node);
+static setAllocatedBitINode(inode * i_node);
+static setDirectoryTypeFile(inode * i_node);
+static buildInodeBitmap();
+static invalidatePathCache();
+static setPathCacheEntry(char * path, int parentInodeNo, int inodeNo);
+static int canonicalPath(char * path, char * key, char ** lastName);
+static setCurrentDirectory(int inode_no);
+static int isFileAlreadyExist(char *fullPath);
+static int getCurrentDirectoryInodeNo();
+static writeFileNameinDir(int inode_no, char * path);
+static setInode1asCurrent();
+static int readV6FS();
+static closeImage();
+static readDirInodeAddr(int inode_number);
+static readFileInodeAddr(int inode_number);
+static initializeSuperBlock(unsigned int totalBlocks, int no_of_Inodes, int useBitmap, int useJournal);
+static initializeFreeBlocks(unsigned int totalBlocks, unsigned int freeNodeStartPoint);
+static int writeBlock(void * data, off_t offset, int isDir);
+static addFreeBlocks(unsigned int freeBlockNo);
+static flushFreedBlocks();
+static releaseFreedBlocks();
+static int removeDirectoryContents(int dirInodeNo, inode * dirInode);
+static prefetchIndirectEntries(unsigned int entries[], int first, int count);
+static loadIndirectBlock(unsigned int blockNo, unsigned int entries[]);
+static int fileExtent(inode * node);
+static int isHashedDirectory(inode * dirInode);
+static int directoryBlock(inode * dirInode, int n);
+static int lookupHashedDir(int dirInodeNo, char * name);
+static dir * collectDirEntries(inode * dirInode, int first, int nblocks, int * count);
+static int convertToHashedDirectory(inode * dirInode);
+static int insertHashedEntry(inode * dirInode, dir * entry);
+static int removeHashedEntry(inode * dirInode, char * name);
+
+//Returns the offset in V6FileSystem of given journal slot
+static off_t journalOffset(int slot)
+{
+    return (off_t) (journalStart + slot) * blockSize;
+}
+
+//Returns where given block is read from: its journal slot while its newest image is in the journal, else its home
+static off_t blockOffset(unsigned int blockNo)
+{
+    if (journalActive && journalSlotOf[blockNo])
+        return journalOffset(journalSlotOf[blockNo]);
+    return (off_t) blockNo * blockSize;
+}
+
+//Returns block number i of given array of on-disk block numbers (an indirect block or a journal record)
+static unsigned int getBlockAddress(void * addrs, int i)
+{
+    if (wideFormat)
+        return ((unsigned int *) addrs)[i];
+    return ((unsigned short *) addrs)[i];
+}
+
+//Stores block number i of given array of on-disk block numbers
+static setBlockAddress(void * addrs, int i, unsigned int blockNo)
+{
+    if (wideFormat)
+        ((unsigned int *) addrs)[i] = blockNo;
+    else
+        ((unsigned short *) addrs)[i] = blockNo;
+}
+
+//Returns journal record i of an array of records, each one block long
+static journalRecord * recordAt(void * records, int i)
+{
+    return (journalRecord *) ((char *) records + (size_t) i * blockSize);
+}
+
+//mmap mode (fsaccess -m): the whole image is mapped and buffers are views into the mapping
+static int useMmap;
+static char *mappedImage;
+static off_t mappedFileSize;
+static size_t mappedReserve;
+
+//Maps V6FileSystem; address space for the largest possible image (16 bit block numbers, all the blocks of
+//a wide V6FileSystem) is reserved up front so that growing the file never moves the mapping
+static mapImage()
+{
+    struct stat st;
+    fstat(fd, & st);
+    mappedFileSize = st.st_size;
+    mappedReserve = (size_t) (wideFormat ? fsBlocks : MAX_BLOCKS) * blockSize;
+    mappedImage = mmap(0, mappedReserve, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mappedImage == MAP_FAILED)
+    {
+        report(" mmap of V6FileSystem failed, using buffered access \n");
+        mappedImage = 0;
+        useMmap = 0;
+    }
+}
+
+//Removes the mapping of V6FileSystem
+static unmapImage()
+{
+    if (mappedImage)
+    {
+        munmap(mappedImage, mappedReserve);
+        mappedImage = 0;
+    }
+}
+
+//Grows the mapped image file so that given block is backed; grows to fsize blocks at once when known
+static ensureImageSize(unsigned int blockNo)
+{
+    off_t needed = ((off_t) blockNo + 1) * blockSize;
+    if (needed <= mappedFileSize)
+        return;
+    pthread_mutex_lock(& cacheLock);
+    if (needed > mappedFileSize)
+    {
+        if ((off_t) fsBlocks * blockSize > needed)
+            needed = (off_t) fsBlocks * blockSize;
+        ftruncate(fd, needed);
+        mappedFileSize = needed;
+    }
+    pthread_mutex_unlock(& cacheLock);
+}
+
+//One read or write of V6FileSystem handed to the I/O engine; pending is decremented when it completes
+typedef struct ioRequest
+{
+    int isWrite;
+    char *data;
+    size_t len;
+    off_t offset;
+    int *pending;
+}ioRequest;
+
+//I/O engine of V6FileSystem: submit() queues a request, wait() returns when the requests counted by pending
+//(all requests when pending is 0) have completed
+typedef struct ioEngine
+{
+    char *name;
+    int isAsync;
+    int (*submit)(ioRequest * req);
+    int (*wait)(int * pending);
+}ioEngine;
+
+static ioEngine *io;
+static int ioWritesInFlight;
+
+//Finishes a request: missing bytes of a short read (end of image) are zero filled, a short write is completed synchronously
+static completeIoRequest(ioRequest * req, ssize_t nbytes)
+{
+    if (nbytes < 0)
+    {
+        if (req->isWrite)
+            report(" Write of V6FileSystem at offset %lld failed: %s \n", (long long) req->offset, strerror(-nbytes));
+        nbytes = 0;
+    }
+    if (!req->isWrite && nbytes < (ssize_t) req->len)
+    {
+        memset(req->data + nbytes, 0, req->len - nbytes);
+    }
+    while (req->isWrite && nbytes < (ssize_t) req->len)
+    {
+        ssize_t n = pwrite(fd, req->data + nbytes, req->len - nbytes, req->offset + nbytes);
+        if (n <= 0)
+            break;
+        nbytes += n;
+    }
+    if (req->isWrite)
+        ioWritesInFlight--;
+    if (req->pending)
+        (*req->pending)--;
+}
+
+//pread/pwrite engine: every request is carried out when it is submitted
+static int syncSubmit(ioRequest * req)
+{
+    ssize_t n;
+    if (req->isWrite)
+        n = pwrite(fd, req->data, req->len, req->offset);
+    else
+        n = pread(fd, req->data, req->len, req->offset);
+    completeIoRequest(req, n < 0 ? -errno : n);
+    return 0;
+}
+
+//Nothing is ever pending: syncSubmit completes each request before it returns
+static int syncWait(int * pending)
+{
+    (void) pending;
+    return 0;
+}
+
+static ioEngine syncEngine = { "pread/pwrite", 0, syncSubmit, syncWait };
+
+#ifdef HAVE_IO_URING
+//io_uring engine: requests are queued in the submission ring and handed to the kernel in batches,
+//so up to IO_QUEUE_DEPTH block requests are in flight at once
+static int ringFd = -1;
+static unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+static unsigned *cqHead, *cqTail, *cqMask;
+static struct io_uring_sqe *sqEntries;
+static struct io_uring_cqe *cqEntries;
+static ioRequest ringRequests[IO_QUEUE_DEPTH];
+static int ringFreeSlots[IO_QUEUE_DEPTH];
+static int ringFreeCount;
+static int ringQueued;
+static int ringInFlight;
+
+//Sets up the submission and completion rings; returns -1 when the kernel does not provide io_uring
+static int uringStart()
+{
+    struct io_uring_params p;
+    size_t sqSize, cqSize;
+    char *sq, *cq;
+    int i;
+    memset(& p, 0, sizeof(p));
+    ringFd = syscall(__NR_io_uring_setup, IO_QUEUE_DEPTH, & p);
+    if (ringFd < 0)
+        return -1;
+    sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if ((p.features & IORING_FEAT_SINGLE_MMAP) && cqSize > sqSize)
+        sqSize = cqSize;
+    sq = mmap(0, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    cq = sq;
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) && sq != MAP_FAILED)
+        cq = mmap(0, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+    sqEntries = mmap(0, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (sq == MAP_FAILED || cq == MAP_FAILED || sqEntries == MAP_FAILED)
+    {
+        close(ringFd);
+        ringFd = -1;
+        return -1;
+    }
+    sqHead = (unsigned *) (sq + p.sq_off.head);
+    sqTail = (unsigned *) (sq + p.sq_off.tail);
+    sqMask = (unsigned *) (sq + p.sq_off.ring_mask);
+    sqArray = (unsigned *) (sq + p.sq_off.array);
+    cqHead = (unsigned *) (cq + p.cq_off.head);
+    cqTail = (unsigned *) (cq + p.cq_off.tail);
+    cqMask = (unsigned *) (cq + p.cq_off.ring_mask);
+    cqEntries = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+    for (i = 0; i < IO_QUEUE_DEPTH; i++)
+    {
+        ringFreeSlots[i] = i;
+    }
+    ringFreeCount = IO_QUEUE_DEPTH;
+    return 0;
+}
+
+//Finishes all the requests found in the completion ring
+static uringReap()
+{
+    unsigned head = *cqHead;
+    while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+    {
+        struct io_uring_cqe *cqe = & cqEntries[head & *cqMask];
+        int slot = cqe->user_data;
+        completeIoRequest(& ringRequests[slot], cqe->res);
+        ringFreeSlots[ringFreeCount++] = slot;
+        ringInFlight--;
+        head++;
+    }
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+}
+
+//Leaves io_uring for the pread/pwrite engine: the queued requests the kernel has not taken are carried out
+//with pread/pwrite and the ones it has taken are waited for
+static uringFallBack()
+{
+    unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    unsigned tail = *sqTail;
+    ringInFlight += ringQueued - (int) (tail - head);
+    for (; head != tail; head++)
+    {
+        int slot = sqEntries[sqArray[head & *sqMask]].user_data;
+        syncSubmit(& ringRequests[slot]);
+        ringFreeSlots[ringFreeCount++] = slot;
+    }
+    ringQueued = 0;
+    for (uringReap(); ringInFlight > 0; uringReap())
+        sched_yield();
+    close(ringFd);
+    ringFd = -1;
+    io = & syncEngine;
+}
+
+//Hands the queued requests to the kernel and waits until at least minComplete requests have completed
+//A full completion ring or a short kernel is waited out; any other failure falls back to pread/pwrite
+static uringEnter(int minComplete)
+{
+    int n, err;
+    for (;;)
+    {
+        n = syscall(__NR_io_uring_enter, ringFd, ringQueued, minComplete, minComplete ? IORING_ENTER_GETEVENTS : 0, 0, 0);
+        err = errno;
+        if (n >= 0 || (err != EINTR && err != EAGAIN && err != EBUSY))
+            break;
+        uringReap();
+        sched_yield();
+    }
+    if (n < 0)
+    {
+        report(" io_uring_enter failed: %s, using pread/pwrite \n", strerror(err));
+        uringFallBack();
+        return;
+    }
+    ringQueued -= n;
+    ringInFlight += n;
+    uringReap();
+}
+
+static int uringSubmit(ioRequest * req)
+{
+    struct io_uring_sqe *sqe;
+    unsigned tail;
+    int slot;
+    while (ringFreeCount == 0 && ringFd >= 0)
+        uringEnter(1);
+    if (ringFd < 0)
+        return syncSubmit(req);
+    slot = ringFreeSlots[--ringFreeCount];
+    ringRequests[slot] = *req;
+    tail = *sqTail;
+    sqe = & sqEntries[tail & *sqMask];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = req->isWrite ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long) req->data;
+    sqe->len = req->len;
+    sqe->off = req->offset;
+    sqe->user_data = slot;
+    sqArray[tail & *sqMask] = tail & *sqMask;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    ringQueued++;
+    if (ringQueued >= IO_SUBMIT_BATCH)
+        uringEnter(0);
+    return 0;
+}
+
+static int uringWait(int * pending)
+{
+    while (ringFd >= 0 && (pending ? *pending > 0 : 1) && ringQueued + ringInFlight > 0)
+        uringEnter(1);
+    return 0;
+}
+
+static ioEngine uringEngine = { "io_uring", 1, uringSubmit, uringWait };
+#endif
+
+//Selects the I/O engine; io_uring is used unless pread/pwrite is requested or the kernel does not support it
+static startIoEngine(int wantAsync)
+{
+    io = & syncEngine;
+#ifdef HAVE_IO_URING
+    if (wantAsync && uringStart() == 0)
+        io = & uringEngine;
+#else
+    (void) wantAsync;
+#endif
+}
+
+//Queues a read of len bytes of V6FileSystem at given offset; *pending (may be 0) counts it until it completes
+static ioRead(void * data, size_t len, off_t offset, int * pending)
+{
+    ioRequest req = { 0, data, len, offset, pending };
+    pthread_mutex_lock(& cacheLock);
+    if (pending)
+        (*pending)++;
+    io->submit(& req);
+    pthread_mutex_unlock(& cacheLock);
+}
+
+//Queues a write of len bytes into V6FileSystem at given offset; data must stay untouched until it completes
+static ioWrite(void * data, size_t len, off_t offset, int * pending)
+{
+    ioRequest req = { 1, data, len, offset, pending };
+    pthread_mutex_lock(& cacheLock);
+    if (pending)
+        (*pending)++;
+    ioWritesInFlight++;
+    io->submit(& req);
+    pthread_mutex_unlock(& cacheLock);
+}
+
+//Waits for the requests counted by pending, or for every queued request when pending is 0
+static ioWait(int * pending)
+{
+    pthread_mutex_lock(& cacheLock);
+    if (pending == 0 || *pending > 0)
+        io->wait(pending);
+    pthread_mutex_unlock(& cacheLock);
+}
+
+//Builds the empty LRU list of buffers; called once before the first block access
+static initializeBufferCache()
+{
+    int i;
+    for (i = 0; i < NBUF; i++)
+    {
+        bufferPool[i].isValid = 0;
+        bufferPool[i].isDirty = 0;
+        bufferPool[i].refCount = 0;
+        bufferPool[i].ioPending = 0;
+        bufferPool[i].hashNext = 0;
+        bufferPool[i].storage = malloc(blockSize);
+        bufferPool[i].data = bufferPool[i].storage;
+        bufferPool[i].lruPrev = (i > 0) ? &bufferPool[i - 1] : 0;
+        bufferPool[i].lruNext = (i < NBUF - 1) ? &bufferPool[i + 1] : 0;
+    }
+    for (i = 0; i < BUF_HASH; i++)
+    {
+        bufferHash[i] = 0;
+    }
+    lruHead = &bufferPool[0];
+    lruTail = &bufferPool[NBUF - 1];
+    bufferCount = NBUF;
+    bufferStorageSize = blockSize;
+}
+
+//Gives every buffer storage for blocks of the current block size; called by setGeometry() while no block is cached
+static resizeBuffers()
+{
+    buffer *bp;
+    if (bufferStorageSize == blockSize || lruHead == 0)
+        return;
+    for (bp = lruHead; bp; bp = bp->lruNext)
+    {
+        free(bp->storage);
+        bp->storage = malloc(blockSize);
+        bp->data = bp->storage;
+    }
+    bufferStorageSize = blockSize;
+}
+
+//Adds a buffer at the LRU tail; the cache grows while the journal keeps modified buffers until they are committed
+static buffer * addBuffer()
+{
+    buffer *bp = calloc(1, sizeof(buffer));
+    bp->storage = malloc(blockSize);
+    bp->data = bp->storage;
+    bp->lruPrev = lruTail;
+    lruTail->lruNext = bp;
+    lruTail = bp;
+    bufferCount++;
+    return bp;
+}
+
+//Returns the cached buffer of given block, 0 when it is not cached; the caller holds cacheLock
+static buffer * findBuffer(unsigned int blockNo)
+{
+    buffer *bp;
+    for (bp = bufferHash[blockNo % BUF_HASH]; bp; bp = bp->hashNext)
+    {
+        if (bp->blockNo == blockNo)
+            return bp;
+    }
+    return 0;
+}
+
+//Moves the given buffer to the head of LRU list
+static touchBuffer(buffer * bp)
+{
+    if (bp == lruHead)
+        return;
+    bp->lruPrev->lruNext = bp->lruNext;
+    if (bp->lruNext)
+        bp->lruNext->lruPrev = bp->lruPrev;
+    else
+        lruTail = bp->lruPrev;
+    bp->lruPrev = 0;
+    bp->lruNext = lruHead;
+    lruHead->lruPrev = bp;
+    lruHead = bp;
+}
+
+//Removes the given buffer from its hash chain
+static unhashBuffer(buffer * bp)
+{
+    buffer **pp = &bufferHash[bp->blockNo % BUF_HASH];
+    while (*pp)
+    {
+        if (*pp == bp)
+        {
+            *pp = bp->hashNext;
+            break;
+        }
+        pp = &(*pp)->hashNext;
+    }
+    bp->hashNext = 0;
+    bp->isValid = 0;
+}
+
+//Drops the cached copy of given block; used before the block is written around the cache
+static forgetBuffer(unsigned int blockNo)
+{
+    buffer *bp;
+    pthread_mutex_lock(& cacheLock);
+    for (bp = bufferHash[blockNo % BUF_HASH]; bp; bp = bp->hashNext)
+    {
+        if (bp->blockNo == blockNo && bp->refCount == 0)
+        {
+            ioWait(& bp->ioPending);
+            unhashBuffer(bp);
+            bp->isDirty = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(& cacheLock);
+}
+
+//Queues the write of given buffer into V6FileSystem if it is modified; mapped buffers are written by msync
+static writeBackBuffer(buffer * bp)
+{
+    if (bp->isValid && bp->isDirty && mappedImage)
+    {
+        bp->isDirty = 0;
+    }
+    else if (bp->isValid && bp->isDirty)
+    {
+        bp->isDirty = 0;
+        ioWrite(bp->data, blockSize, (off_t) bp->blockNo * blockSize, & bp->ioPending);
+    }
+}
+
+//Queues the writes of the least recently used modified buffers together; used when a dirty buffer has to be recycled
+static writeBackOldBuffers()
+{
+    buffer *bp;
+    int n = 0;
+    for (bp = lruTail; bp && n < IO_QUEUE_DEPTH; bp = bp->lruPrev)
+    {
+        if (bp->refCount == 0 && bp->ioPending == 0 && bp->isValid && bp->isDirty)
+        {
+            writeBackBuffer(bp);
+            n++;
+        }
+    }
+}
+
+//Returns the buffer for given block without reading it from disk; least recently used unused buffer is recycled on miss
+static buffer * getBuffer(unsigned int blockNo)
+{
+    buffer *bp;
+    pthread_mutex_lock(& cacheLock);
+    for (bp = bufferHash[blockNo % BUF_HASH]; bp; bp = bp->hashNext)
+    {
+        if (bp->blockNo == blockNo)
+        {
+            bp->refCount++;
+            ioWait(& bp->ioPending);
+            touchBuffer(bp);
+            pthread_mutex_unlock(& cacheLock);
+            return bp;
+        }
+    }
+    for (bp = lruTail; bp && (bp->refCount > 0 || bp->ioPending > 0 || (journalActive && bp->isDirty)); bp = bp->lruPrev)
+        ;
+    //With the journal, modified buffers stay in the cache until they are committed; once the journal has no room
+    //for more, those of blocks allocated in the open transaction are written home to make room
+    if (bp == 0 && journalActive && (journalCanGrowCache() || writeBackFreshBuffers() == 0))
+        bp = addBuffer();
+    if (bp == 0)
+    {
+        for (bp = lruTail; bp && (bp->refCount > 0 || (journalActive && bp->isDirty)); bp = bp->lruPrev)
+            ;
+        //Every buffer is held by a caller: the cache grows by one
+        if (bp == 0)
+            bp = addBuffer();
+        ioWait(& bp->ioPending);
+    }
+    if (bp->isValid && bp->isDirty && !mappedImage)
+    {
+        writeBackOldBuffers();
+        ioWait(& bp->ioPending);
+    }
+    if (bp->isValid)
+        unhashBuffer(bp);
+    bp->blockNo = blockNo;
+    bp->isValid = 0;
+    bp->isDirty = 0;
+    bp->refCount = 1;
+    bp->data = bp->storage;
+    if (mappedImage)
+    {
+        ensureImageSize(blockNo);
+        bp->data = mappedImage + ((off_t) blockNo * blockSize);
+        bp->isValid = 1;
+    }
+    bp->hashNext = bufferHash[blockNo % BUF_HASH];
+    bufferHash[blockNo % BUF_HASH] = bp;
+    touchBuffer(bp);
+    pthread_mutex_unlock(& cacheLock);
+    return bp;
+}
+
+//Queues the read of given buffer's block; writes still in flight are completed first so that the block is read back as written
+static queueBufferRead(buffer * bp)
+{
+    if (ioWritesInFlight > 0)
+        ioWait(0);
+    bp->isValid = 1;
+    ioRead(bp->data, blockSize, blockOffset(bp->blockNo), & bp->ioPending);
+}
+
+//Returns the buffer for given block holding its contents; blocks beyond end of image read as zeros
+static buffer * readBuffer(unsigned int blockNo)
+{
+    pthread_mutex_lock(& cacheLock);
+    buffer *bp = getBuffer(blockNo);
+    if (!bp->isValid)
+    {
+        queueBufferRead(bp);
+        ioWait(& bp->ioPending);
+    }
+    pthread_mutex_unlock(& cacheLock);
+    return bp;
+}
+
+//Releases the buffer after use
+static releaseBuffer(buffer * bp)
+{
+    pthread_mutex_lock(& cacheLock);
+    bp->refCount--;
+    pthread_mutex_unlock(& cacheLock);
+}
+
+//Marks the buffer modified and releases it; data reaches disk on flushBufferCache() or eviction
+static releaseDirtyBuffer(buffer * bp)
+{
+    pthread_mutex_lock(& cacheLock);
+    bp->isValid = 1;
+    bp->isDirty = 1;
+    bp->refCount--;
+    pthread_mutex_unlock(& cacheLock);
+}
+
+//Writes all the modified buffers back into V6FileSystem; in mmap mode writeback of the mapping is started
+static flushBufferCache()
+{
+    buffer *bp;
+    pthread_mutex_lock(& cacheLock);
+    for (bp = lruHead; bp; bp = bp->lruNext)
+    {
+        writeBackBuffer(bp);
+    }
+    ioWait(0);
+    pthread_mutex_unlock(& cacheLock);
+    if (mappedImage)
+        msync(mappedImage, mappedFileSize, MS_ASYNC);
+}
+
+//Drops all cached blocks without writing them; used when V6FileSystem is recreated
+static invalidateBufferCache()
+{
+    int i;
+    buffer *bp;
+    pthread_mutex_lock(& cacheLock);
+    ioWait(0);
+    for (bp = lruHead; bp; bp = bp->lruNext)
+    {
+        bp->isValid = 0;
+        bp->isDirty = 0;
+        bp->hashNext = 0;
+    }
+    for (i = 0; i < BUF_HASH; i++)
+    {
+        bufferHash[i] = 0;
+    }
+    pthread_mutex_unlock(& cacheLock);
+}
+
+//Reads len bytes of V6FileSystem from given offset through the buffer cache
+static readFromFS(off_t offset, void * data, int len)
+{
+    char *dest = data;
+    if (mappedImage)
+    {
+        ensureImageSize((offset + len - 1) / blockSize);
+        memcpy(dest, mappedImage + offset, len);
+        return;
+    }
+    while (len > 0)
+    {
+        int start = offset % blockSize;
+        int n = blockSize - start;
+        if (n > len)
+            n = len;
+        buffer *bp = readBuffer(offset / blockSize);
+        memcpy(dest, bp->data + start, n);
+        releaseBuffer(bp);
+        dest += n;
+        offset += n;
+        len -= n;
+    }
+}
+
+//Writes len bytes into V6FileSystem at given offset through the buffer cache
+static writeIntoFS(off_t offset, void * data, int len)
+{
+    char *src = data;
+    if (mappedImage)
+    {
+        ensureImageSize((offset + len - 1) / blockSize);
+        memcpy(mappedImage + offset, src, len);
+        return;
+    }
+    while (len > 0)
+    {
+        int start = offset % blockSize;
+        int n = blockSize - start;
+        if (n > len)
+            n = len;
+        buffer *bp = (n == blockSize) ? getBuffer(offset / blockSize) : readBuffer(offset / blockSize);
+        memcpy(bp->data + start, src, n);
+        releaseDirtyBuffer(bp);
+        src += n;
+        offset += n;
+        len -= n;
+    }
+}
+
+//Checksum (FNV-1a) of a block written into given journal slot; the checksum of a transaction is the sum over its blocks
+static unsigned int journalChecksum(char * data, int slot)
+{
+    unsigned int h = 2166136261u ^ slot;
+    int i;
+    for (i = 0; i < blockSize; i++)
+    {
+        h = (h ^ (unsigned char) data[i]) * 16777619u;
+    }
+    return h;
+}
+
+//Writes the journal header with the sequence number of the next transaction and makes it durable
+static writeJournalHeader()
+{
+    journalRecord *header = calloc(1, blockSize);
+    int pending = 0;
+    header->magic = JOURNAL_MAGIC;
+    header->type = JOURNAL_HEADER;
+    header->sequence = journalSequence;
+    ioWrite(header, blockSize, journalOffset(0), & pending);
+    ioWait(& pending);
+    fdatasync(fd);
+    free(header);
+}
+
+//Sets up the journal of the opened V6FileSystem; in mmap mode blocks are changed in place through the mapping
+//and the journal is not used
+static startJournal()
+{
+    journalActive = journalStart != 0 && !mappedImage;
+    if (!journalActive)
+        return;
+    free(journalSlotOf);
+    free(journalRevoked);
+    free(journalFresh);
+    journalSlotOf = calloc(fsBlocks, sizeof(unsigned short));
+    journalRevoked = calloc(fsBlocks, 1);
+    journalFresh = calloc(fsBlocks, 1);
+    journalRevokeCount = 0;
+    journalHomeWrites = 0;
+    journalTail = 1;
+}
+
+//Replays the committed transactions of the journal into their home blocks; called when V6FileSystem is opened,
+//after setGeometry() and before anything is read through the buffer cache. A transaction without its commit record
+//or whose checksum does not match was cut short and is dropped with everything after it
+static replayJournal(super_block * sb)
+{
+    journalRecord *rec;
+    char *image;
+    unsigned short *latest, *opSlot;
+    unsigned int *opBlock;
+    unsigned int sequence, sum = 0;
+    int slot = 1, ops = 0, transactions = 0, i;
+    unsigned int b;
+    if (journalStart == 0)
+        return;
+    rec = malloc(blockSize);
+    image = malloc(blockSize);
+    if (pread(fd, rec, blockSize, journalOffset(0)) != blockSize || rec->magic != JOURNAL_MAGIC || rec->type != JOURNAL_HEADER)
+    {
+        free(rec);
+        free(image);
+        return;
+    }
+    sequence = rec->sequence;
+    latest = calloc(fsBlocks, sizeof(unsigned short));
+    opBlock = malloc(sb->journalSize * journalEntries * sizeof(unsigned int));
+    opSlot = malloc(sb->journalSize * journalEntries * sizeof(unsigned short));
+    while (slot < sb->journalSize && pread(fd, rec, blockSize, journalOffset(slot)) == blockSize)
+    {
+        if (rec->magic != JOURNAL_MAGIC || rec->sequence != sequence)
+            break;
+        if (rec->type == JOURNAL_COMMIT)
+        {
+            if (rec->checksum != sum)
+                break;
+            //Revokes void the images logged before them, later images win
+            for (i = 0; i < ops; i++)
+            {
+                latest[opBlock[i]] = opSlot[i];
+            }
+            transactions++;
+            sequence++;
+            ops = 0;
+            sum = 0;
+            slot++;
+            continue;
+        }
+        if ((rec->type != JOURNAL_DESCRIPTOR && rec->type != JOURNAL_REVOKE) || rec->count > journalEntries)
+            break;
+        sum += journalChecksum((char *) rec, slot);
+        for (i = 0; i < rec->count; i++)
+        {
+            opBlock[ops] = getBlockAddress(rec->blocks, i);
+            opSlot[ops] = 0;
+            if (opBlock[ops] >= fsBlocks)
+                break;
+            if (rec->type == JOURNAL_DESCRIPTOR)
+            {
+                opSlot[ops] = slot + 1 + i;
+                pread(fd, image, blockSize, journalOffset(slot + 1 + i));
+                sum += journalChecksum(image, slot + 1 + i);
+            }
+            ops++;
+        }
+        if (i < rec->count)
+            break;
+        slot += 1 + (rec->type == JOURNAL_DESCRIPTOR ? rec->count : 0);
+    }
+    for (b = 0; b < fsBlocks && transactions > 0; b++)
+    {
+        if (latest[b] == 0)
+            continue;
+        pread(fd, image, blockSize, journalOffset(latest[b]));
+        pwrite(fd, image, blockSize, (off_t) b * blockSize);
+    }
+    if (transactions > 0)
+    {
+        fdatasync(fd);
+        journalSequence = sequence;
+        writeJournalHeader();
+        report(" Journal: %d transactions replayed \n", transactions);
+    }
+    journalSequence = sequence;
+    free(latest);
+    free(opBlock);
+    free(opSlot);
+    free(rec);
+    free(image);
+}
+
+//Returns the number of journal slots left for the open transaction, keeping room for its revoke and commit records
+static int journalRoom()
+{
+    return superblock.journalSize - journalTail - (journalRevokeCount / journalEntries) - 3;
+}
+
+//Checks the buffer cache may grow by one more modified buffer, which needs a journal slot at commit
+//(cache size is used as bound of the modified buffers); a full journal is checkpointed first
+static int journalCanGrowCache()
+{
+    int needed = bufferCount + 1 + (bufferCount + 1) / journalEntries + 1;
+    if (needed <= journalRoom())
+        return 1;
+    if (journalTail > 1)
+        checkpointJournal();
+    return needed <= journalRoom();
+}
+
+//Writes the modified buffers of blocks allocated in the open transaction into their home blocks, as file data is;
+//the commit record is only written once they are on disk. The caller holds cacheLock. Returns the number written
+static int writeBackFreshBuffers()
+{
+    buffer *bp;
+    int n = 0;
+    for (bp = lruTail; bp; bp = bp->lruPrev)
+    {
+        if (bp->refCount == 0 && bp->ioPending == 0 && bp->isValid && bp->isDirty && journalFresh[bp->blockNo])
+        {
+            bp->isDirty = 0;
+            ioWrite(bp->data, blockSize, (off_t) bp->blockNo * blockSize, & bp->ioPending);
+            n++;
+        }
+    }
+    if (n > 0)
+        journalHomeWrites = 1;
+    return n;
+}
+
+//Drops the open transaction when it does not fit in the journal even after its fresh blocks went home. None of its
+//other blocks has been written, so V6FileSystem is reopened in the state of the last commit and the command fails
+static abortJournal()
+{
+    report(" Journal too small for the changes since the last commit, they are dropped \n");
+    closeImage();
+    readV6FS();
+    commandDone = 0;
+    journalDropped = 1;
+}
+
+//Returns the number of modified buffers; the caller holds cacheLock
+static int countDirtyBuffers()
+{
+    buffer *bp;
+    int n = 0;
+    for (bp = lruHead; bp; bp = bp->lruNext)
+    {
+        if (bp->isValid && bp->isDirty)
+            n++;
+    }
+    return n;
+}
+
+//Revokes the journal images of a block being freed or allocated, so that neither the checkpoint nor a replay
+//writes them over what the block holds next (free-chain blocks are logged while they are free); its cached copy
+//is dropped as well
+static journalRevokeBlock(unsigned int blockNo)
+{
+    if (__atomic_load_n(& journalSlotOf[blockNo], __ATOMIC_RELAXED) == 0)
+        return;
+    pthread_mutex_lock(& cacheLock);
+    forgetBuffer(blockNo);
+    if (journalSlotOf[blockNo])
+    {
+        __atomic_store_n(& journalSlotOf[blockNo], 0, __ATOMIC_RELAXED);
+        if (!journalRevoked[blockNo])
+            journalRevokeCount++;
+        journalRevoked[blockNo] = 1;
+    }
+    pthread_mutex_unlock(& cacheLock);
+}
+
+//Writes given record into the next journal slot and adds it to the transaction checksum
+static appendJournalRecord(journalRecord * rec, unsigned int * sum)
+{
+    *sum += journalChecksum((char *) rec, journalTail);
+    ioWrite(rec, blockSize, journalOffset(journalTail), 0);
+    journalTail++;
+}
+
+//Commits every block modified since the last commit as one transaction with a single fdatasync; blocks freed
+//in the transaction are released and the free blocks and super block are written into the cache first so that
+//they are part of it. Committed buffers are clean; the lazy checkpoint runs once half the journal is used
+//Returns -1 when the transaction did not fit and was dropped
+static int commitJournal()
+{
+    buffer *bp, **dirty;
+    char *records;
+    journalRecord *rec;
+    unsigned int sum = 0;
+    int i, n, nrec = 0;
+    unsigned int b;
+    flushDataRun();
+    ioWait(0);
+    releaseFreedBlocks();
+    syncFreeChain();
+    syncSuperBlock();
+    pthread_mutex_lock(& cacheLock);
+    n = countDirtyBuffers();
+    if (n == 0 && journalRevokeCount == 0)
+    {
+        pthread_mutex_unlock(& cacheLock);
+        return 0;
+    }
+    if (n + n / journalEntries + 1 > journalRoom())
+        checkpointJournal();
+    if (n + n / journalEntries + 1 > journalRoom())
+        n -= writeBackFreshBuffers();
+    if (n + n / journalEntries + 1 > journalRoom())
+    {
+        pthread_mutex_unlock(& cacheLock);
+        abortJournal();
+        return -1;
+    }
+    dirty = malloc((n + 1) * sizeof(buffer *));
+    records = calloc(n / journalEntries + journalRevokeCount / journalEntries + 3, blockSize);
+    n = 0;
+    for (bp = lruHead; bp; bp = bp->lruNext)
+    {
+        if (bp->isValid && bp->isDirty)
+            dirty[n++] = bp;
+    }
+    //Revokes first: an image of the same block in this transaction comes after them and is kept
+    for (b = 0; b < fsBlocks && journalRevokeCount > 0; b++)
+    {
+        if (!journalRevoked[b])
+            continue;
+        journalRevoked[b] = 0;
+        journalRevokeCount--;
+        if (recordAt(records, nrec)->count == journalEntries)
+            appendJournalRecord(recordAt(records, nrec++), & sum);
+        rec = recordAt(records, nrec);
+        rec->magic = JOURNAL_MAGIC;
+        rec->type = JOURNAL_REVOKE;
+        rec->sequence = journalSequence;
+        setBlockAddress(rec->blocks, rec->count++, b);
+        if (journalRevokeCount == 0)
+            appendJournalRecord(recordAt(records, nrec++), & sum);
+    }
+    for (i = 0; i < n; i++)
+    {
+        rec = recordAt(records, nrec);
+        if (i % journalEntries == 0)
+        {
+            rec->magic = JOURNAL_MAGIC;
+            rec->type = JOURNAL_DESCRIPTOR;
+            rec->sequence = journalSequence;
+            rec->count = (n - i < journalEntries) ? n - i : journalEntries;
+        }
+        setBlockAddress(rec->blocks, i % journalEntries, dirty[i]->blockNo);
+        if (i % journalEntries == rec->count - 1)
+        {
+            int first = i - (i % journalEntries), j;
+            appendJournalRecord(recordAt(records, nrec++), & sum);
+            for (j = first; j <= i; j++)
+            {
+                sum += journalChecksum(dirty[j]->data, journalTail);
+                __atomic_store_n(& journalSlotOf[dirty[j]->blockNo], journalTail, __ATOMIC_RELAXED);
+                dirty[j]->isDirty = 0;
+                ioWrite(dirty[j]->data, blockSize, journalOffset(journalTail++), & dirty[j]->ioPending);
+            }
+        }
+    }
+    //Fresh blocks written home become reachable with the commit, so they are made durable before it
+    if (journalHomeWrites)
+    {
+        ioWait(0);
+        fdatasync(fd);
+        journalHomeWrites = 0;
+    }
+    rec = recordAt(records, nrec);
+    rec->magic = JOURNAL_MAGIC;
+    rec->type = JOURNAL_COMMIT;
+    rec->sequence = journalSequence;
+    rec->checksum = sum;
+    ioWrite(rec, blockSize, journalOffset(journalTail++), 0);
+    ioWait(0);
+    fdatasync(fd);
+    journalSequence++;
+    journalCommits++;
+    memset(journalFresh, 0, fsBlocks);
+    free(records);
+    free(dirty);
+    if (journalTail > superblock.journalSize / 2)
+        checkpointJournal();
+    pthread_mutex_unlock(& cacheLock);
+    return 0;
+}
+
+//Writes the newest committed image of every journaled block to its home block and empties the journal; blocks
+//modified in the open transaction stay in the cache and only their committed images are written home
+static checkpointJournal()
+{
+    char *image = malloc(blockSize);
+    buffer *bp;
+    unsigned int b;
+    pthread_mutex_lock(& cacheLock);
+    ioWait(0);
+    for (b = 0; b < fsBlocks && journalTail > 1; b++)
+    {
+        if (journalSlotOf[b] == 0)
+            continue;
+        bp = findBuffer(b);
+        if (bp && bp->isValid && !bp->isDirty && bp->ioPending == 0)
+            ioWrite(bp->data, blockSize, (off_t) b * blockSize, & bp->ioPending);
+        else
+        {
+            pread(fd, image, blockSize, journalOffset(journalSlotOf[b]));
+            pwrite(fd, image, blockSize, (off_t) b * blockSize);
+        }
+        __atomic_store_n(& journalSlotOf[b], 0, __ATOMIC_RELAXED);
+    }
+    if (journalTail > 1)
+    {
+        ioWait(0);
+        fdatasync(fd);
+        memset(journalRevoked, 0, fsBlocks);
+        journalRevokeCount = 0;
+        journalTail = 1;
+        writeJournalHeader();
+    }
+    pthread_mutex_unlock(& cacheLock);
+    free(image);
+}
+
+//Commits the open transaction and checkpoints the journal, so that every block is in its home location;
+//used by sync and on exit
+static syncJournal()
+{
+    if (!journalActive)
+        return;
+    commitJournal();
+    checkpointJournal();
+}
+
+//Checks the open transaction holds more modified blocks than half the journal room left, the point at which it is
+//committed before it could outgrow the journal
+static int journalHalfFull()
+{
+    pthread_mutex_lock(& cacheLock);
+    int full = countDirtyBuffers() * 2 > journalRoom();
+    pthread_mutex_unlock(& cacheLock);
+    return full;
+}
+
+//Called inside a command where V6FileSystem is consistent (between the files of rm -r and cpin-many): commits the
+//open transaction once it is half full, so that a command changing more blocks than the journal holds is split into
+//several transactions; with group commit the commands before it are committed as well. cpin-many workers are
+//between two files while it runs. Returns -1 when the transaction was dropped and the command has to stop
+static int journalSafePoint()
+{
+    int result = 0;
+    if (!journalActive || !journalHalfFull())
+        return 0;
+    pthread_rwlock_wrlock(& transactionLock);
+    if (journalHalfFull())
+    {
+        flushFreedBlocks();
+        result = commitJournal();
+    }
+    pthread_rwlock_unlock(& transactionLock);
+    return result;
+}
+
+//In-memory name index of one directory: open addressing table of entries, empty slot has inode_no 0
+//lock serializes the updates of the directory (its data blocks, inode and index) between bulk copy workers
+//A hashed directory (hashed set) is looked up in its hash buckets on disk and keeps no slots
+typedef struct dirIndex
+{
+    int dirInodeNo;
+    int hashed;
+    int count;
+    int capacity;
+    dir *slots;
+    pthread_mutex_t lock;
+    struct dirIndex *next;
+}dirIndex;
+
+//Name indexes of the directories accessed so far, hashed on directory inode number
+static dirIndex *dirIndexTable[DIR_INDEX_HASH];
+static pthread_mutex_t dirIndexTableLock = PTHREAD_MUTEX_INITIALIZER;
+
+//Hash of a directory entry name (at most 14 characters)
+static unsigned int hashFileName(char * name)
+{
+    unsigned int h = 2166136261u;
+    int i;
+    for (i = 0; i < 14 && name[i]; i++)
+    {
+        h = (h ^ (unsigned char) name[i]) * 16777619u;
+    }
+    return h;
+}
+
+//Returns the slot holding given name, or the empty slot where it would be inserted
+static dir * findDirIndexSlot(dirIndex * index, char * name)
+{
+    unsigned int mask = index->capacity - 1;
+    unsigned int pos = hashFileName(name) & mask;
+    while (index->slots[pos].inode_no != 0 && strncmp(index->slots[pos].file_name, name, 14) != 0)
+    {
+        pos = (pos + 1) & mask;
+    }
+    return & index->slots[pos];
+}
+
+//Doubles the slot table of given index and rehashes its entries
+static growDirIndex(dirIndex * index)
+{
+    dir *oldSlots = index->slots;
+    int oldCapacity = index->capacity;
+    int i;
+    index->capacity *= 2;
+    index->slots = calloc(index->capacity, sizeof(dir));
+    for (i = 0; i < oldCapacity; i++)
+    {
+        if (oldSlots[i].inode_no != 0)
+            *findDirIndexSlot(index, oldSlots[i].file_name) = oldSlots[i];
+    }
+    free(oldSlots);
+}
+
+//Adds name -> inode number into the directory index
+static addDirIndexEntry(dirIndex * index, char * name, int inode_no)
+{
+    if (index->hashed)
+        return;
+    if ((index->count + 1) * 4 > index->capacity * 3)
+        growDirIndex(index);
+    dir *slot = findDirIndexSlot(index, name);
+    if (slot->inode_no == 0)
+        index->count++;
+    slot->inode_no = inode_no;
+    strncpy(slot->file_name, name, 14);
+}
+
+//Removes given name from the directory index; following entries of the probe run are shifted back
+static removeDirIndexEntry(dirIndex * index, char * name)
+{
+    if (index->hashed)
+        return;
+    unsigned int mask = index->capacity - 1;
+    dir *slot = findDirIndexSlot(index, name);
+    if (slot->inode_no == 0)
+        return;
+    unsigned int hole = slot - index->slots;
+    unsigned int pos = hole;
+    index->slots[hole].inode_no = 0;
+    index->count--;
+    while (1)
+    {
+        pos = (pos + 1) & mask;
+        if (index->slots[pos].inode_no == 0)
+            break;
+        unsigned int home = hashFileName(index->slots[pos].file_name) & mask;
+        //Move the entry into the hole unless its home lies cyclically between the hole and its position
+        if (((pos - home) & mask) >= ((pos - hole) & mask))
+        {
+            index->slots[hole] = index->slots[pos];
+            index->slots[pos].inode_no = 0;
+            hole = pos;
+        }
+    }
+}
+
+//Returns inode number of given name from the directory index; 0 if not present
+static int lookupDirIndex(dirIndex * index, char * name)
+{
+    if (index->hashed)
+        return lookupHashedDir(index->dirInodeNo, name);
+    return findDirIndexSlot(index, name)->inode_no;
+}
+
+//Returns the name index of given directory, reading its data blocks on first access (except for a hashed directory)
+static dirIndex * getDirIndex(int dirInodeNo, inode * dirInode)
+{
+    dirIndex *index;
+    int i, j;
+    pthread_mutex_lock(& dirIndexTableLock);
+    for (index = dirIndexTable[dirInodeNo % DIR_INDEX_HASH]; index; index = index->next)
+    {
+        if (index->dirInodeNo == dirInodeNo)
+        {
+            pthread_mutex_unlock(& dirIndexTableLock);
+            return index;
+        }
+    }
+    index = calloc(1, sizeof(dirIndex));
+    index->dirInodeNo = dirInodeNo;
+    index->hashed = isHashedDirectory(dirInode);
+    index->capacity = 64;
+    index->slots = calloc(index->capacity, sizeof(dir));
+    pthread_mutex_init(& index->lock, 0);
+    for (i = 0; i < 8 && !index->hashed; i++)
+    {
+        if (dirInode->addr[i] == 0)
+            continue;
+        buffer *bp = readBuffer(dirInode->addr[i]);
+        dir *entries = (dir *) bp->data;
+        for (j = 0; j < (int) (blockSize / sizeof(dir)); j++)
+        {
+            if (entries[j].inode_no > 0)
+                addDirIndexEntry(index, entries[j].file_name, entries[j].inode_no);
+        }
+        releaseBuffer(bp);
+    }
+    index->next = dirIndexTable[dirInodeNo % DIR_INDEX_HASH];
+    dirIndexTable[dirInodeNo % DIR_INDEX_HASH] = index;
+    pthread_mutex_unlock(& dirIndexTableLock);
+    return index;
+}
+
+//Locks given directory for an update and loads it as current directory of this thread; returns its name index
+static dirIndex * lockDirectory(int dirInodeNo)
+{
+    inode dirInode;
+    readInode(dirInodeNo, & dirInode);
+    dirIndex *index = getDirIndex(dirInodeNo, & dirInode);
+    pthread_mutex_lock(& index->lock);
+    setCurrentDirectory(dirInodeNo);
+    return index;
+}
+
+//Unlocks a directory locked by lockDirectory()
+static unlockDirectory(dirIndex * index)
+{
+    pthread_mutex_unlock(& index->lock);
+}
+
+//Drops the name index of given directory; used when the directory is removed
+static dropDirIndex(int dirInodeNo)
+{
+    dirIndex **pp;
+    pthread_mutex_lock(& dirIndexTableLock);
+    for (pp = & dirIndexTable[dirInodeNo % DIR_INDEX_HASH]; *pp; pp = & (*pp)->next)
+    {
+        if ((*pp)->dirInodeNo == dirInodeNo)
+        {
+            dirIndex *index = *pp;
+            *pp = index->next;
+            free(index->slots);
+            free(index);
+            break;
+        }
+    }
+    pthread_mutex_unlock(& dirIndexTableLock);
+}
+
+//Drops the name indexes of all directories; used when V6FileSystem is recreated
+static invalidateDirIndexes()
+{
+    int i;
+    for (i = 0; i < DIR_INDEX_HASH; i++)
+    {
+        while (dirIndexTable[i])
+        {
+            dirIndex *index = dirIndexTable[i];
+            dirIndexTable[i] = index->next;
+            free(index->slots);
+            free(index);
+        }
+    }
+}
+
+//Writes the in-memory super block into V6FileSystem if it has been modified since last sync
+static syncSuperBlock()
+{
+    if (superblock.fmod)
+    {
+        superblock.fmod = 0;
+        writeIntoFS(512, & superblock, sizeof(super_block));
+    }
+}
+
+//Persists the super block and all modified blocks; called once at the end of every command
+//With the journal the command's blocks are committed instead; with group commit (fsaccess -g) commands share
+//a commit until sync, exit, a command freeing blocks or the journal filling up
+static syncFS()
+{
+    flushDataRun();
+    ioWait(0);
+    if (journalActive)
+    {
+        //Blocks freed by the command only become reusable once it commits
+        int commitNow = !groupCommit || freedBlockCount > 0 || journalHalfFull();
+        if (commitNow)
+            commitJournal();
+        return;
+    }
+    syncFreeChain();
+    syncSuperBlock();
+    flushBufferCache();
+}
+
+//Waits until the mapped image is written to disk; used by sync and on exit in mmap mode
+static syncMappedImage()
+{
+    if (mappedImage)
+        msync(mappedImage, mappedFileSize, MS_SYNC);
+}
+
+//Marks given block in use in the free-block bitmap; the caller holds the lock of its allocation group
+//A free-chain window can straddle two groups, so its dirty flag is set atomically
+static markBlockUsed(unsigned int blockNo)
+{
+    if (journalActive)
+    {
+        journalRevokeBlock(blockNo);
+        journalFresh[blockNo] = 1;
+    }
+    blockBitmap[blockNo / 64] |= 1ULL << (blockNo % 64);
+    allocGroups[blockNo / groupBlocks].freeCount--;
+    allocGroups[blockNo / groupBlocks].bitmapDirty = 1;
+    if (!bitmapStart)
+        __atomic_store_n(& freeWindowDirty[blockNo / FREE_WINDOW], 1, __ATOMIC_RELAXED);
+    __atomic_store_n(& blockBitmapDirty, 1, __ATOMIC_RELAXED);
+}
+
+//Checks given block is free
+static int isBlockFree(int blockNo)
+{
+    return !((blockBitmap[blockNo / 64] >> (blockNo % 64)) & 1);
+}
+
+//Marks the given blocks, sorted in ascending order, free in the free-block bitmap;
+//each allocation group is locked once for all of its blocks
+static markBlocksFree(unsigned int blocks[], int count)
+{
+    int i = 0;
+    while (i < count)
+    {
+        allocGroup *g = & allocGroups[blocks[i] / groupBlocks];
+        int group = blocks[i] / groupBlocks;
+        pthread_mutex_lock(& g->lock);
+        if ((int) blocks[i] < g->searchStart)
+            g->searchStart = blocks[i];
+        for (; i < count && (int) blocks[i] / groupBlocks == group; i++)
+        {
+            unsigned int blockNo = blocks[i];
+            if (isBlockFree(blockNo))
+                continue;
+            if (journalActive)
+                journalRevokeBlock(blockNo);
+            blockBitmap[blockNo / 64] &= ~(1ULL << (blockNo % 64));
+            g->freeCount++;
+            g->bitmapDirty = 1;
+            if (!bitmapStart)
+                __atomic_store_n(& freeWindowDirty[blockNo / FREE_WINDOW], 1, __ATOMIC_RELAXED);
+            __atomic_store_n(& blockBitmapDirty, 1, __ATOMIC_RELAXED);
+        }
+        pthread_mutex_unlock(& g->lock);
+    }
+}
+
+//Marks given block free in the free-block bitmap
+static markBlockFree(unsigned int blockNo)
+{
+    markBlocksFree(& blockNo, 1);
+}
+
+//Returns the first word in [word, endWord) of the free-block bitmap that differs from pattern, endWord if none;
+//~0ULL skips words of used blocks, 0 skips words of free blocks
+static int scanBitmapWords(int word, int endWord, unsigned long long pattern)
+{
+    while (word < endWord && blockBitmap[word] == pattern)
+        word++;
+    return word;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+//AVX2 version of scanBitmapWords(): compares four words at a time
+__attribute__((target("avx2")))
+static int scanBitmapWordsAvx2(int word, int endWord, unsigned long long pattern)
+{
+    __m256i p = _mm256_set1_epi64x(pattern);
+    while (word + 4 <= endWord)
+    {
+        __m256i v = _mm256_loadu_si256((__m256i *) & blockBitmap[word]);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi64(v, p)) != -1)
+            break;
+        word += 4;
+    }
+    return scanBitmapWords(word, endWord, pattern);
+}
+#endif
+
+static int (*scanWords)(int word, int endWord, unsigned long long pattern) = scanBitmapWords;
+
+//Uses the AVX2 bitmap scan when the processor supports it; other processors keep the word by word scan
+static selectBitmapScan()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        scanWords = scanBitmapWordsAvx2;
+#endif
+}
+
+//Returns the first free block at or after given block and below end; 0 if there is none
+static unsigned int nextFreeBlockBefore(int blockNo, int end)
+{
+    int endWord = (end + 63) / 64;
+    if (blockNo >= end)
+        return 0;
+    unsigned long long freeBits = ~blockBitmap[blockNo / 64] & (~0ULL << (blockNo % 64));
+    if (!freeBits)
+    {
+        int word = scanWords(blockNo / 64 + 1, endWord, ~0ULL);
+        if (word >= endWord)
+            return 0;
+        freeBits = ~blockBitmap[word];
+        blockNo = word * 64;
+    }
+    blockNo = (blockNo & ~63) + __builtin_ctzll(freeBits);
+    return blockNo < end ? blockNo : 0;
+}
+
+//Returns the length of the run of free blocks starting at given free block, counting at most max blocks below end
+static int freeRunLength(int blockNo, int max, int end)
+{
+    int limit = (blockNo + max < end) ? blockNo + max : end;
+    int b = blockNo;
+    unsigned long long usedBits = blockBitmap[b / 64] >> (b % 64);
+    if (usedBits)
+        b += __builtin_ctzll(usedBits);
+    else
+    {
+        int endWord = (limit + 63) / 64;
+        int word = scanWords(b / 64 + 1, endWord, 0);
+        b = word * 64;
+        if (word < endWord)
+            b += __builtin_ctzll(blockBitmap[word]);
+    }
+    return (b < limit ? b : limit) - blockNo;
+}
+
+//Returns the first free block at or after given block; 0 if there is none
+static unsigned int nextFreeBlock(int blockNo)
+{
+    return nextFreeBlockBefore(blockNo, fsBlocks);
+}
+
+//Returns the number of blocks of the on-disk free-block bitmap of a file system of given size
+static int bitmapBlockCount(unsigned int totalBlocks)
+{
+    return (totalBlocks + groupBlocks - 1) / groupBlocks;
+}
+
+//Allocates the free-block bitmap for fsBlocks blocks, rounded up to whole allocation groups, with every block in use
+static allocateBlockBitmap()
+{
+    int groups = bitmapBlockCount(fsBlocks) > 0 ? bitmapBlockCount(fsBlocks) : 1;
+    free(blockBitmap);
+    blockBitmapWords = groups * (groupBlocks / 64);
+    blockBitmap = malloc(blockBitmapWords * sizeof(unsigned long long));
+    memset(blockBitmap, 0xff, blockBitmapWords * sizeof(unsigned long long));
+}
+
+//Builds the free-block bitmap: read from the on-disk bitmap when V6FileSystem has one, else from the free chain
+static buildBlockBitmap()
+{
+    allocateBlockBitmap();
+    memset(freeWindowDirty, 0, sizeof(freeWindowDirty));
+    memset(windowHolder, 0, sizeof(windowHolder));
+    if (bitmapStart)
+        readFromFS((off_t) blockSize * bitmapStart, blockBitmap, bitmapBlockCount(fsBlocks) * blockSize);
+    else
+        readFreeChain();
+    blockBitmapDirty = 0;
+    blockBitmapBuilt = 1;
+    buildAllocGroups();
+}
+
+//Clears the bits of the blocks on the free chain (super block list, then chain blocks)
+//Also notes whether the chain is already laid out one group per FREE_WINDOW blocks
+//Entries beyond fsBlocks are skipped and a link beyond it ends the chain, so a damaged chain cannot reach past the bitmap
+static readFreeChain()
+{
+    unsigned short nfree = superblock.nfree;
+    unsigned short list[100];
+    int i, lastWindow = -1, groups = 0;
+    memcpy(list, superblock.free, sizeof(list));
+    chainInWindowFormat = (nfree == 0);
+    while (nfree < 100 && groups < MAX_BLOCKS)
+    {
+        for (i = 1; i <= nfree; i++)
+        {
+            if (list[i] >= fsBlocks)
+            {
+                chainInWindowFormat = 0;
+                continue;
+            }
+            blockBitmap[list[i] / 64] &= ~(1ULL << (list[i] % 64));
+            if (groups > 0 && list[i] / FREE_WINDOW != lastWindow)
+                chainInWindowFormat = 0;
+        }
+        unsigned short link = list[0];
+        if (link == 0)
+            break;
+        if (link >= fsBlocks)
+        {
+            report(" Free chain links to block %d beyond the %u blocks of V6FileSystem, rest of the chain ignored \n", link, fsBlocks);
+            chainInWindowFormat = 0;
+            break;
+        }
+        blockBitmap[link / 64] &= ~(1ULL << (link % 64));
+        if ((int) (link / FREE_WINDOW) <= lastWindow)
+            chainInWindowFormat = 0;
+        lastWindow = link / FREE_WINDOW;
+        windowHolder[lastWindow] = link;
+        readFromFS(512 * link, & nfree, sizeof(nfree));
+        readFromFS(512 * link + sizeof(nfree), list, sizeof(unsigned short) * ((nfree < 100 ? nfree : 99) + 1));
+        groups++;
+    }
+}
+
+//Splits the free-block bitmap into allocation groups of groupBlocks blocks and counts their free blocks
+//allocGroupsInitialized is the number of groups whose lock has been set up
+static buildAllocGroups()
+{
+    int g, w;
+    allocGroupCount = bitmapBlockCount(fsBlocks);
+    if (allocGroupCount < 1)
+        allocGroupCount = 1;
+    if (allocGroupCount > allocGroupsInitialized)
+    {
+        allocGroups = realloc(allocGroups, allocGroupCount * sizeof(allocGroup));
+        for (g = allocGroupsInitialized; g < allocGroupCount; g++)
+            pthread_mutex_init(& allocGroups[g].lock, 0);
+        allocGroupsInitialized = allocGroupCount;
+    }
+    for (g = 0; g < allocGroupCount; g++)
+    {
+        allocGroups[g].freeCount = 0;
+        allocGroups[g].bitmapDirty = 0;
+        allocGroups[g].searchStart = g * groupBlocks;
+        for (w = g * (groupBlocks / 64); w < (g + 1) * (groupBlocks / 64); w++)
+        {
+            allocGroups[g].freeCount += __builtin_popcountll(~blockBitmap[w]);
+        }
+    }
+}
+
+//Selects the allocation group the following block allocations of this thread start in
+static setAllocationGroup(int group)
+{
+    allocGroupHint = group;
+}
+
+//Returns the allocation group of given directory: the group holding its first data block
+static int directoryGroup(inode * dirInode)
+{
+    return dirInode->addr[0] / groupBlocks;
+}
+
+//Returns the group for a new directory: the one with the most free blocks, so that directories
+//(and the files placed with them) spread over the disk
+static int pickDirectoryGroup()
+{
+    int g, best = 0;
+    for (g = 1; g < allocGroupCount; g++)
+    {
+        if (__atomic_load_n(& allocGroups[g].freeCount, __ATOMIC_RELAXED) > __atomic_load_n(& allocGroups[best].freeCount, __ATOMIC_RELAXED))
+            best = g;
+    }
+    return best;
+}
+
+//Writes the chain group of given window into its holder block: free[0] links to the next group, free[1..nfree]
+//holds the other free blocks of the window in descending order so that blocks are handed out in ascending order
+static writeFreeWindow(int window, unsigned short holder, unsigned short nextHolder)
+{
+    unsigned short group[V6_BLOCK_SIZE / sizeof(unsigned short)] = {0};
+    int b, n = 0;
+    int end = (window + 1) * FREE_WINDOW;
+    for (b = nextFreeBlock(holder + 1); b != 0 && b < end; b = nextFreeBlock(b + 1))
+    {
+        n++;
+    }
+    group[0] = n;
+    group[1] = nextHolder;
+    for (b = nextFreeBlock(holder + 1); b != 0 && b < end; b = nextFreeBlock(b + 1))
+    {
+        group[1 + n--] = b;
+    }
+    //The whole block is written so that the buffer cache does not read it first
+    writeIntoFS(512 * holder, group, V6_BLOCK_SIZE);
+}
+
+//Writes the blocks of the on-disk free-block bitmap whose allocation group changed since the last sync;
+//one bitmap block covers exactly one group
+static syncFreeBitmap()
+{
+    int g;
+    for (g = 0; g < bitmapBlockCount(fsBlocks); g++)
+    {
+        if (allocGroups[g].bitmapDirty)
+        {
+            allocGroups[g].bitmapDirty = 0;
+            writeIntoFS((off_t) blockSize * (bitmapStart + g), & blockBitmap[g * (groupBlocks / 64)], blockSize);
+        }
+    }
+    blockBitmapDirty = 0;
+}
+
+//Persists the free-block bitmap as the V6 free chain, one group per FREE_WINDOW blocks so that
+//only the groups of windows changed since the last sync (and the link into them) are rewritten
+//File systems created with an on-disk bitmap get their bitmap blocks written instead
+static syncFreeChain()
+{
+    int w, p;
+    int windows = MAX_BLOCKS / FREE_WINDOW + 1;
+    if (!blockBitmapDirty)
+        return;
+    if (bitmapStart)
+    {
+        syncFreeBitmap();
+        return;
+    }
+    for (w = windows - 1; w >= 0; w--)
+    {
+        if (!freeWindowDirty[w] && chainInWindowFormat)
+            continue;
+        freeWindowDirty[w] = 0;
+        unsigned short holder = nextFreeBlock(w * FREE_WINDOW);
+        if (holder >= (w + 1) * FREE_WINDOW)
+            holder = 0;
+        if (holder != windowHolder[w])
+        {
+            windowHolder[w] = holder;
+            //Group of the previous window links to this one
+            for (p = w - 1; p >= 0 && windowHolder[p] == 0; p--)
+                ;
+            if (p >= 0)
+                freeWindowDirty[p] = 1;
+        }
+        if (holder)
+        {
+            unsigned short nextHolder = 0;
+            for (p = w + 1; p < windows && nextHolder == 0; p++)
+                nextHolder = windowHolder[p];
+            writeFreeWindow(w, holder, nextHolder);
+        }
+    }
+    memset(superblock.free, 0, sizeof(superblock.free));
+    superblock.nfree = 0;
+    for (w = 0; w < windows && superblock.free[0] == 0; w++)
+        superblock.free[0] = windowHolder[w];
+    superblock.fmod = 1;
+    chainInWindowFormat = 1;
+    blockBitmapDirty = 0;
+}
+
+//Takes up to count blocks of given group into blocks[]: the first run of count contiguous free blocks, or when
+//partial is set the lowest free blocks; the caller holds the group lock. Returns the number of blocks taken
+static int takeGroupBlocks(int group, int count, unsigned int blocks[], int partial)
+{
+    allocGroup *g = & allocGroups[group];
+    int end = (group + 1) * groupBlocks;
+    int lowest, start, n = 0;
+    if (g->freeCount < (partial ? 1 : count))
+        return 0;
+    lowest = start = nextFreeBlockBefore(g->searchStart, end);
+    while (!partial && start != 0)
+    {
+        int len = freeRunLength(start, count, end);
+        if (len == count)
+            break;
+        start = nextFreeBlockBefore(start + len, end);
+    }
+    for (; start != 0 && n < count; start = nextFreeBlockBefore(start + 1, end))
+    {
+        markBlockUsed(start);
+        blocks[n++] = start;
+    }
+    //Everything below the search start is in use
+    if (n > 0 && (int) blocks[0] == lowest)
+        g->searchStart = lowest + 1;
+    return n;
+}
+
+//Allocates count blocks into blocks[], starting in the allocation group of this thread: the first run of count
+//contiguous free blocks in that group or the following ones, else the lowest free blocks of those groups in turn
+//Groups locked by other threads are passed over while another group can serve the run
+//Returns the number of blocks allocated
+static int allocateBlocks(int count, unsigned int blocks[])
+{
+    char busy[allocGroupCount];
+    int k, n = 0;
+    if (count <= 0)
+        return 0;
+    memset(busy, 0, sizeof(busy));
+    for (k = 0; k < allocGroupCount && count <= groupBlocks; k++)
+    {
+        int group = (allocGroupHint + k) % allocGroupCount;
+        if (pthread_mutex_trylock(& allocGroups[group].lock) != 0)
+        {
+            busy[group] = 1;
+            continue;
+        }
+        n = takeGroupBlocks(group, count, blocks, 0);
+        pthread_mutex_unlock(& allocGroups[group].lock);
+        if (n == count)
+            return n;
+    }
+    for (k = 0; k < allocGroupCount && count <= groupBlocks; k++)
+    {
+        int group = (allocGroupHint + k) % allocGroupCount;
+        if (!busy[group])
+            continue;
+        pthread_mutex_lock(& allocGroups[group].lock);
+        n = takeGroupBlocks(group, count, blocks, 0);
+        pthread_mutex_unlock(& allocGroups[group].lock);
+        if (n == count)
+            return n;
+    }
+    n = 0;
+    for (k = 0; k < allocGroupCount && n < count; k++)
+    {
+        int group = (allocGroupHint + k) % allocGroupCount;
+        pthread_mutex_lock(& allocGroups[group].lock);
+        n += takeGroupBlocks(group, count - n, blocks + n, 1);
+        pthread_mutex_unlock(& allocGroups[group].lock);
+    }
+    return n;
+}
+
+//This function returns the next available free block (lowest numbered in the allocation group of this thread);
+//only the in-memory bitmap is updated
+static unsigned int getFreeBlockk() 
+{
+    unsigned int freeBlock;
+    if (allocateBlocks(1, & freeBlock) == 0) 
+	{
+        progress(" Free Block over \n ");
+        return 0;
+    }
+	return freeBlock;
+}
+
+//Blocks reserved for the file being copied in
+typedef struct blockReservation
+{
+    unsigned int *blocks;
+    int count;
+    int next;
+}blockReservation;
+
+static __thread blockReservation dataReservation;
+static __thread blockReservation indirectReservation;
+
+//Block map of a file being written by cpin: the current single indirect block, the current double indirect
+//block and the triple indirect block are kept in memory with their fill cursors and each is written once
+typedef struct blockMapBuilder
+{
+    inode *i_node;
+    int nblocks;
+    int singleIndex;
+    unsigned int singleBlockNo;
+    int singleCount;
+    unsigned int doubleBlockNo;
+    unsigned int single[MAX_INDIRECT_ENTRIES];
+    unsigned int doubleEntries[MAX_INDIRECT_ENTRIES];
+    unsigned int tripleEntries[MAX_INDIRECT_ENTRIES];
+}blockMapBuilder;
+
+//Block map of a file collected by cpout, in logical order
+typedef struct blockList
+{
+    unsigned int *blocks;
+    int count;
+    int capacity;
+}blockList;
+
+//Reserves count blocks, contiguous when possible
+static reserveBlocks(blockReservation * r, int count)
+{
+    r->blocks = malloc(sizeof(unsigned int) * (count > 0 ? count : 1));
+    r->count = allocateBlocks(count, r->blocks);
+    r->next = 0;
+}
+
+//Returns the unused reserved blocks into free list
+static releaseReservation(blockReservation * r)
+{
+    while (r->next < r->count)
+    {
+        markBlockFree(r->blocks[r->next++]);
+    }
+    free(r->blocks);
+    r->blocks = 0;
+    r->count = 0;
+    r->next = 0;
+}
+
+//Returns next block of given reservation; allocates a new block once the reservation is used up
+static unsigned int takeReservedBlock(blockReservation * r)
+{
+    if (r->next < r->count)
+        return r->blocks[r->next++];
+    return getFreeBlockk();
+}
+
+//Returns the number of single/double/triple indirect blocks a large file of given number of data blocks needs
+static int countIndirectBlocks(int nblocks)
+{
+    if (nblocks <= 8)
+        return 0;
+    int singles = (nblocks + indirectEntries - 1) / indirectEntries;
+    if (singles <= singleSlots)
+        return singles;
+    int doubles = (singles - singleSlots + doubleIndirectEntries - 1) / doubleIndirectEntries;
+    return singles + doubles + (doubles > 1);
+}
+
+//Queues the write of pending run of consecutive data blocks into V6FileSystem and moves on to the next run slot
+static flushDataRun()
+{
+    if (dataRunCount == 0)
+        return;
+    if (mappedImage)
+    {
+        ensureImageSize(dataRunStart + dataRunCount - 1);
+        memcpy(mappedImage + ((off_t) dataRunStart * blockSize), dataRunBuf[dataRunSlot], dataRunCount * blockSize);
+    }
+    else
+    {
+        ioWrite(dataRunBuf[dataRunSlot], dataRunCount * blockSize, (off_t) dataRunStart * blockSize, & dataRunPending[dataRunSlot]);
+        dataRunSlot = (dataRunSlot + 1) % DATA_RUN_SLOTS;
+        ioWait(& dataRunPending[dataRunSlot]);
+    }
+    dataRunCount = 0;
+}
+
+//Writes one file data block; consecutive blocks are collected and written together by flushDataRun()
+static writeDataBlock(unsigned int blockNo, char * data)
+{
+    forgetBuffer(blockNo);
+    if (dataRunCount > 0 && (blockNo != dataRunStart + dataRunCount || (dataRunCount + 1) * blockSize > DATA_RUN_BYTES))
+        flushDataRun();
+    if (dataRunCount == 0)
+        dataRunStart = blockNo;
+    memcpy(dataRunBuf[dataRunSlot] + (dataRunCount * blockSize), data, blockSize);
+    dataRunCount++;
+}
+
+//Prints given message of fsaccess; the library (V6FS_LIBRARY) prints nothing, its callers get return codes
+static report(const char * format, ...)
+{
+#ifndef V6FS_LIBRARY
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+#else
+    (void) format;
+#endif
+}
+
+//Prints given progress message of a command; left out in batch mode
+static progress(char * message)
+{
+    if (!batchMode)
+        report("%s", message);
+}
+
+//Marks the current command as completed and prints its success message
+static commandSucceeded(char * message)
+{
+    commandDone = 1;
+    progress(message);
+}
+
+// Initializes the file system with the given total number of blocks & total number of inodes
+// Also initializes the super block contents & creates root directory
+// With useBitmap set, free blocks are kept in an on-disk bitmap after the inode blocks instead of the V6 free chain
+// With useJournal set, a journal area follows (free blocks then always use the bitmap) and metadata updates are committed through it
+// With wideBlockSize set, V6FileSystem is created in the wide format with blocks of that size (free blocks always use the bitmap)
+static initializeFS(unsigned int totalBlocks, int no_of_Inodes, int useBitmap, int useJournal, int wideBlockSize)
+{
+	if (wideBlockSize && (wideBlockSize < MIN_WIDE_BLOCK_SIZE || wideBlockSize > MAX_BLOCK_SIZE || (wideBlockSize & (wideBlockSize - 1))))
+	{
+		report(" Block size must be a power of 2 from %d to %d \n", MIN_WIDE_BLOCK_SIZE, MAX_BLOCK_SIZE);
+		return;
+	}
+	if (totalBlocks > (wideBlockSize ? MAX_WIDE_BLOCKS : MAX_BLOCKS - 1) || no_of_Inodes < 1 || no_of_Inodes > 65535)
+	{
+		report(" Too many blocks or inodes for the %s format \n", wideBlockSize ? "wide" : "V6");
+		return;
+	}
+
+	unmapImage();
+	invalidateBufferCache();
+	journalActive = 0;
+	journalOpened = 1;
+	freedBlockCount = 0;
+	if (imageOpen)
+		close(fd);
+	imageOpen = 0;
+	fd = open(imageFile, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (fd < 0)
+	{
+		report(" Cannot create V6FileSystem \n");
+		return;
+	}
+	imageOpen = 1;
+	setGeometry(wideBlockSize != 0, wideBlockSize ? wideBlockSize : V6_BLOCK_SIZE);
+	fsBlocks = totalBlocks;
+	//The image gets its full size at once; fallocate also reserves its space where the file system supports it.
+	//The image was truncated, so the inode blocks read back as zero and are not written here
+	if (fallocate(fd, 0, 0, (off_t) totalBlocks * blockSize) != 0)
+		ftruncate(fd, (off_t) totalBlocks * blockSize);
+	if (useMmap)
+		mapImage();
+	invalidateDirIndexes();
+	invalidatePathCache();
+
+	initializeSuperBlock(totalBlocks, no_of_Inodes, useBitmap, useJournal);
+
+	initializeRootInode();
+	buildInodeBitmap();
+	syncFS();
+	if (journalStart)
+	{
+		journalSequence = 1;
+		writeJournalHeader();
+		startJournal();
+	}
+    
+    commandSucceeded(" V6FileSystem initialized successfully \n");
+}
+
+//Sets the geometry globals for V6FileSystem in the wide format (wide set) or the V6 format with given block size
+static setGeometry(int wide, int size)
+{
+	wideFormat = wide;
+	blockSize = size;
+	addrSize = wide ? sizeof(unsigned int) : sizeof(unsigned short);
+	inodeSize = wide ? sizeof(wideInode) : sizeof(v6Inode);
+	inodesPerBlock = blockSize / inodeSize;
+	indirectEntries = blockSize / addrSize;
+	doubleIndirectEntries = wide ? indirectEntries : MAX_DOUBLE_ENTRIES;
+	singleSlots = wide ? 6 : 7;
+	tripleIndirect = wide;
+	long long singles = singleSlots + doubleIndirectEntries + (wide ? (long long) doubleIndirectEntries * doubleIndirectEntries : 0);
+	maxFileBlocks = (singles * indirectEntries > INT_MAX) ? INT_MAX : singles * indirectEntries;
+	groupBlocks = blockSize * 8;
+	journalEntries = (blockSize - sizeof(journalRecord)) / addrSize;
+	resizeBuffers();
+}
+
+//Returns the number of blocks of the opened image file, at most the blocks a V6 block number can address
+static unsigned int imageFileBlocks()
+{
+	struct stat st;
+	if (fstat(fd, & st) < 0)
+		return 0;
+	if ((st.st_size + V6_BLOCK_SIZE - 1) / V6_BLOCK_SIZE > MAX_BLOCKS - 1)
+		return MAX_BLOCKS - 1;
+	return (st.st_size + V6_BLOCK_SIZE - 1) / V6_BLOCK_SIZE;
+}
+
+//Takes the geometry of V6FileSystem from given super block; returns -1 when it records no usable geometry
+//A V6 image whose fsize is 0 (made before initfs recorded it) is taken to span the whole image file
+static int loadGeometry(super_block * sb)
+{
+	if (sb->wideMagic != WIDE_MAGIC)
+	{
+		setGeometry(0, V6_BLOCK_SIZE);
+		fsBlocks = sb->fsize ? sb->fsize : imageFileBlocks();
+		bitmapStart = sb->bitmap;
+		journalStart = sb->journal;
+		if (fsBlocks < 3 || bitmapStart >= fsBlocks || journalStart >= fsBlocks)
+			return -1;
+		return 0;
+	}
+	if (sb->blockSize < MIN_WIDE_BLOCK_SIZE || sb->blockSize > MAX_BLOCK_SIZE || (sb->blockSize & (sb->blockSize - 1))
+		|| sb->blocks > MAX_WIDE_BLOCKS || sb->bitmapBlock == 0)
+		return -1;
+	setGeometry(1, sb->blockSize);
+	fsBlocks = sb->blocks;
+	bitmapStart = sb->bitmapBlock;
+	journalStart = sb->journalBlock;
+	return 0;
+}
+
+//Returns the offset in V6FileSystem of given inode; the inode blocks start at block 2
+static off_t inodeOffset(int inode_no)
+{
+	return (off_t) 2 * blockSize + (off_t) (inode_no - 1) * inodeSize;
+}
+
+//Reads given inode of V6FileSystem into node from the on-disk inode of the format
+static readInode(int inode_no, inode * node)
+{
+	int i;
+	memset(node, 0, sizeof(inode));
+	if (wideFormat)
+	{
+		wideInode w;
+		readFromFS(inodeOffset(inode_no), & w, sizeof(w));
+		node->flags = w.flags;
+		node->nlinks = w.nlinks;
+		node->uid = w.uid;
+		node->gid = w.gid;
+		node->size = w.size;
+		memcpy(node->addr, w.addr, sizeof(node->addr));
+		memcpy(node->actime, w.actime, sizeof(node->actime));
+		memcpy(node->modtime, w.modtime, sizeof(node->modtime));
+		return;
+	}
+	v6Inode v;
+	readFromFS(inodeOffset(inode_no), & v, sizeof(v));
+	node->flags = v.flags;
+	node->nlinks = v.nlinks;
+	node->uid = v.uid;
+	node->gid = v.gid;
+	node->size0 = v.size0;
+	node->size1 = v.size1;
+	for (i = 0; i < 8; i++)
+	{
+		node->addr[i] = v.addr[i];
+	}
+	memcpy(node->actime, v.actime, sizeof(node->actime));
+	memcpy(node->modtime, v.modtime, sizeof(node->modtime));
+}
+
+//Writes node into given inode of V6FileSystem as the on-disk inode of the format
+static writeInode(int inode_no, inode * node)
+{
+	int i;
+	if (wideFormat)
+	{
+		wideInode w;
+		memset(& w, 0, sizeof(w));
+		w.flags = node->flags;
+		w.nlinks = node->nlinks;
+		w.uid = node->uid;
+		w.gid = node->gid;
+		w.size = node->size;
+		memcpy(w.addr, node->addr, sizeof(w.addr));
+		memcpy(w.actime, node->actime, sizeof(w.actime));
+		memcpy(w.modtime, node->modtime, sizeof(w.modtime));
+		writeIntoFS(inodeOffset(inode_no), & w, sizeof(w));
+		return;
+	}
+	v6Inode v;
+	v.flags = node->flags;
+	v.nlinks = node->nlinks;
+	v.uid = node->uid;
+	v.gid = node->gid;
+	v.size0 = node->size0;
+	v.size1 = node->size1;
+	for (i = 0; i < 8; i++)
+	{
+		v.addr[i] = node->addr[i];
+	}
+	memcpy(v.actime, node->actime, sizeof(v.actime));
+	memcpy(v.modtime, node->modtime, sizeof(v.modtime));
+	writeIntoFS(inodeOffset(inode_no), & v, sizeof(v));
+}
+
+//Initialize the inode for root directory
+static initializeRootInode()
+{
+	inode rootInodeData;
+	readInode(1, & rootInodeData);
+	setAllocatedBitINode( & rootInodeData);
+
+	setDirectoryTypeFile( & rootInodeData);
+
+	dir dirData;
+	dirData.inode_no = 1;
+	strcpy(dirData.file_name, ".");
+
+	writeDirBlock(& dirData, & rootInodeData);
+
+	dirData.inode_no = 1;
+	strcpy(dirData.file_name, "..");
+	writeDirBlock(& dirData, & rootInodeData);
+
+	writeInode(1, & rootInodeData);
+    current_inode = rootInodeData;
+    current_inode_no = 1;
+
+}
+
+//Sets all the fields in single and double indirect blocks to zero
+static initializeToZero(unsigned int block)
+{
+    buffer *bp = getBuffer(block);
+    memset(bp->data, 0, blockSize);
+    releaseDirtyBuffer(bp);
+}
+
+//Write data into Directory Data Block; a new zeroed block is added to addr[] when the existing ones are full
+//A directory with all 8 blocks full turns into a hashed directory, which takes the entry into its buckets
+static int writeDirBlock(void * data, inode * i_node) 
+{
+	int i;
+	if (isHashedDirectory(i_node))
+		return insertHashedEntry(i_node, data);
+	for (i = 0; i < 8; i++)
+	{
+		if (i_node->addr[i] == 0)
+		{
+			//A new directory starts in the emptiest allocation group, its further blocks stay in that group
+			setAllocationGroup(i == 0 ? pickDirectoryGroup() : directoryGroup(i_node));
+			unsigned int freeBlockNo = getFreeBlockk();
+			if (freeBlockNo == 0)
+			{
+				return -1;
+			}
+			initializeToZero(freeBlockNo);
+			i_node->addr[i] = freeBlockNo;
+		}
+		if (writeBlock(data, (off_t) i_node->addr[i] * blockSize, 1) > 0)
+		{
+			return 0;
+		}
+	}
+	if (convertToHashedDirectory(i_node) < 0)
+		return -1;
+	return insertHashedEntry(i_node, data);
+}
+
+//Sets the allocated bit for the given inode
+static setAllocatedBitINode(inode * i_node)
+{
+	i_node->flags |= (1 << 15);
+}
+
+//Resets the allocated bit for the given inode
+static resetAllocatedBitInode(inode * i_node) 
+{
+	i_node->flags &= ~(1 << 15);
+}
+
+//Records the size of the file in size0 (high byte) and size1; only the low 24 bits fit, fileSize() restores the rest
+//The inode of a wide V6FileSystem keeps the whole size
+static setFileSize(inode * i_node, off_t size)
+{
+	i_node->size0 = (size >> 16) & 0xff;
+	i_node->size1 = size & 0xffff;
+	i_node->size = size;
+}
+
+//Sets the Largefile bit for the given inode
+static setLargeFileBitINode(inode * i_node)
+{
+	i_node->flags |= (1 << 12);
+}
+
+//Resets the Largefile bit for the given inode
+static resetLargeFileBitInode(inode * i_node)
+{
+	i_node->flags &= ~(1 << 12);
+}
+
+//Sets the filetype bits for the given inode
+static setDirectoryTypeFile(inode * i_node)
+{
+	i_node->flags |= (1 << 14);
+	i_node->flags &= ~(1 << 13);
+}
+
+//Checks given inode is allcoated to any file or not
+static int isAllocatedInode(inode * i_node) 
+{
+    return ((i_node->flags >> 15) & 1);
+}
+
+//Checks given file is small or large
+static int isLargeFile(inode * i_node)
+{
+    return ((i_node->flags >> 12) & 1);
+}
+
+//Checks given inode is for file or directory
+static int isDirectory(inode * i_node)
+{
+    return (((i_node->flags >> 14) & 1) & ~((i_node->flags >> 13) & 1));
+}
+
+//Builds the free-inode bitmap from the on-disk inode table; bit (n-1) is set when inode n is allocated
+static buildInodeBitmap()
+{
+	int i, j;
+	int words = (superblock.isize + 63) / 64;
+	free(inodeBitmap);
+	inodeBitmap = calloc(words > 0 ? words : 1, sizeof(unsigned long long));
+	inodeBitmapWords = words;
+	inodeSearchStart = 0;
+	for (i = 0; i < superblock.isize; i += inodesPerBlock)
+	{
+		buffer *bp = readBuffer(2 + (i / inodesPerBlock));
+		for (j = 0; j < inodesPerBlock && i + j < superblock.isize; j++)
+		{
+			//flags come first in the inodes of both formats
+			if ((*(unsigned short *) (bp->data + j * inodeSize) >> 15) & 1)
+				inodeBitmap[(i + j) / 64] |= 1ULL << ((i + j) % 64);
+		}
+		releaseBuffer(bp);
+	}
+	//Bits past the last inode are marked used so that the search never returns them
+	for (i = superblock.isize; i < words * 64; i++)
+	{
+		inodeBitmap[i / 64] |= 1ULL << (i % 64);
+	}
+}
+
+//Get next available free inode; the inode is reserved in the bitmap and isize + 1 is returned when none is left
+//The bit is claimed with compare-and-swap so that concurrent workers never get the same inode
+static int getFreeInode()
+{
+	int i, pass;
+	for (pass = 0; pass < 2; pass++)
+	{
+		for (i = (pass == 0) ? __atomic_load_n(& inodeSearchStart, __ATOMIC_RELAXED) : 0; i < inodeBitmapWords; i++)
+		{
+			unsigned long long word = __atomic_load_n(& inodeBitmap[i], __ATOMIC_RELAXED);
+			while (~word)
+			{
+				int bit = __builtin_ctzll(~word);
+				if (__atomic_compare_exchange_n(& inodeBitmap[i], & word, word | (1ULL << bit), 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+				{
+					__atomic_store_n(& inodeSearchStart, i, __ATOMIC_RELAXED);
+					return (i * 64) + bit + 1;
+				}
+			}
+		}
+	}
+	__atomic_store_n(& inodeSearchStart, inodeBitmapWords, __ATOMIC_RELAXED);
+	return superblock.isize + 1;
+}
+
+//Returns the given inode number to the free-inode bitmap
+static freeInodeNumber(int inode_no)
+{
+	int i = (inode_no - 1) / 64;
+	__atomic_fetch_and(& inodeBitmap[i], ~(1ULL << ((inode_no - 1) % 64)), __ATOMIC_ACQ_REL);
+	if (i < __atomic_load_n(& inodeSearchStart, __ATOMIC_RELAXED))
+		__atomic_store_n(& inodeSearchStart, i, __ATOMIC_RELAXED);
+}
+
+//Writes the indirectEntries entries of an indirect block kept in memory into given block
+static writeIndirectBlock(unsigned int blockNo, unsigned int entries[])
+{
+    int i;
+    buffer *bp = getBuffer(blockNo);
+    for (i = 0; i < indirectEntries; i++)
+    {
+        setBlockAddress(bp->data, i, entries[i]);
+    }
+    releaseDirtyBuffer(bp);
+}
+
+//Starts the block map of an empty file
+static startBlockMap(blockMapBuilder * map, inode * i_node)
+{
+    map->i_node = i_node;
+    map->nblocks = 0;
+    map->singleIndex = 0;
+    map->singleBlockNo = 0;
+    map->singleCount = 0;
+    map->doubleBlockNo = 0;
+}
+
+//Writes the current double indirect block (when there is one) and starts double indirect block number index
+//of the file: addr[singleSlots] for the first one, an entry of the triple indirect block addr[7] after that
+static int nextDoubleIndirectBlock(blockMapBuilder * map, int index)
+{
+    if (map->doubleBlockNo != 0)
+    {
+        writeIndirectBlock(map->doubleBlockNo, map->doubleEntries);
+    }
+    unsigned int blockNo = takeReservedBlock(& indirectReservation);
+    if (blockNo == 0)
+    {
+        return -1;
+    }
+    if (index == 0)
+    {
+        map->i_node->addr[singleSlots] = blockNo;
+    }
+    else
+    {
+        if (map->i_node->addr[7] == 0)
+        {
+            map->i_node->addr[7] = takeReservedBlock(& indirectReservation);
+            if (map->i_node->addr[7] == 0)
+            {
+                markBlockFree(blockNo);
+                return -1;
+            }
+            memset(map->tripleEntries, 0, indirectEntries * sizeof(unsigned int));
+        }
+        map->tripleEntries[index - 1] = blockNo;
+    }
+    map->doubleBlockNo = blockNo;
+    memset(map->doubleEntries, 0, indirectEntries * sizeof(unsigned int));
+    return 0;
+}
+
+//Writes the current single indirect block (when there is one) and starts a new one in the next addr[] slot,
+//or in the current double indirect block once the single slots of addr[] are used; returns -1 when no block is left
+static int nextSingleIndirectBlock(blockMapBuilder * map)
+{
+    if (map->singleBlockNo != 0)
+    {
+        writeIndirectBlock(map->singleBlockNo, map->single);
+    }
+    if ((long long) (map->singleIndex + 1) * indirectEntries > maxFileBlocks)
+    {
+        report(" Max file size reached \n");
+        return -1;
+    }
+    unsigned int blockNo = takeReservedBlock(& indirectReservation);
+    if (blockNo == 0)
+    {
+        return -1;
+    }
+    int index = map->singleIndex - singleSlots;
+    if (index < 0)
+    {
+        map->i_node->addr[map->singleIndex] = blockNo;
+    }
+    else
+    {
+        if (index % doubleIndirectEntries == 0 && nextDoubleIndirectBlock(map, index / doubleIndirectEntries) < 0)
+        {
+            markBlockFree(blockNo);
+            return -1;
+        }
+        map->doubleEntries[index % doubleIndirectEntries] = blockNo;
+    }
+    map->singleIndex++;
+    map->singleBlockNo = blockNo;
+    map->singleCount = 0;
+    memset(map->single, 0, indirectEntries * sizeof(unsigned int));
+    return 0;
+}
+
+//Adds next data block of the file into its block map; addr[] holds the first 8 data blocks, after that the file
+//turns large and addr[] holds single indirect blocks (then the double and triple indirect blocks)
+static int addDataBlock(blockMapBuilder * map, unsigned int blockNo)
+{
+    int i;
+    if (!isLargeFile(map->i_node))
+    {
+        if (map->nblocks < 8)
+        {
+            map->i_node->addr[map->nblocks++] = blockNo;
+            return 0;
+        }
+        //Move the 8 direct blocks into the first single indirect block
+        unsigned int direct[8];
+        memcpy(direct, map->i_node->addr, sizeof(direct));
+        memset(map->i_node->addr, 0, sizeof(direct));
+        if (nextSingleIndirectBlock(map) < 0)
+        {
+            memcpy(map->i_node->addr, direct, sizeof(direct));
+            return -1;
+        }
+        setLargeFileBitINode(map->i_node);
+        for (i = 0; i < 8; i++)
+        {
+            map->single[map->singleCount++] = direct[i];
+        }
+    }
+    if (map->singleCount == indirectEntries && nextSingleIndirectBlock(map) < 0)
+    {
+        return -1;
+    }
+    map->single[map->singleCount++] = blockNo;
+    map->nblocks++;
+    return 0;
+}
+
+//Writes the partially filled indirect blocks of the file; called once after its last data block
+static finishBlockMap(blockMapBuilder * map)
+{
+    if (map->singleBlockNo != 0)
+    {
+        writeIndirectBlock(map->singleBlockNo, map->single);
+    }
+    if (map->doubleBlockNo != 0)
+    {
+        writeIndirectBlock(map->doubleBlockNo, map->doubleEntries);
+    }
+    if (tripleIndirect && map->i_node->addr[7] != 0 && isLargeFile(map->i_node))
+    {
+        writeIndirectBlock(map->i_node->addr[7], map->tripleEntries);
+    }
+}
+
+//Adds count holes (logical blocks without a data block) into the file's block map
+static int addHoles(blockMapBuilder * map, int count)
+{
+    while (count-- > 0)
+    {
+        if (addDataBlock(map, 0) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+//Returns 1 when all bytes of given block are zero
+static int isZeroBlock(char * data)
+{
+    unsigned long long *words = (unsigned long long *) data;
+    int i;
+    for (i = 0; i < (int) (blockSize / sizeof(unsigned long long)); i++)
+    {
+        if (words[i] != 0)
+            return 0;
+    }
+    return 1;
+}
+
+//Writes the given data block into the file and adds it into the file's block map
+static int writeToFile(char data[], blockMapBuilder * map)
+{
+    unsigned int freeBlockNo = takeReservedBlock(& dataReservation);
+    if (freeBlockNo == 0)
+    {
+        return -1;
+    }
+    if (addDataBlock(map, freeBlockNo) < 0)
+    {
+        markBlockFree(freeBlockNo);
+        return -1;
+    }
+    writeDataBlock(freeBlockNo, data);
+    return 0;
+}
+
+//Bounded lock-free ring of data chunks between the reader and the writer stage of cpin/cpout;
+//exactly one thread produces (advances tail) and one consumes (advances head)
+//skip is the length of a file hole that cpout leaves in the output file before the data of the chunk
+typedef struct chunkRing
+{
+    char data[PIPE_SLOTS][PIPE_CHUNK];
+    int length[PIPE_SLOTS];
+    int pending[PIPE_SLOTS];
+    off_t skip[PIPE_SLOTS];
+    atomic_uint head;
+    atomic_uint tail;
+    atomic_int finished;
+}chunkRing;
+
+static chunkRing pipeRing;
+
+//Empties the ring before a copy starts
+static resetChunkRing(chunkRing * r)
+{
+    atomic_store(& r->head, 0);
+    atomic_store(& r->tail, 0);
+    atomic_store(& r->finished, 0);
+}
+
+//Producer: waits until chunk seq fits into the ring and returns its buffer; this bounds the memory of a copy
+static char * waitForFreeChunk(chunkRing * r, unsigned seq)
+{
+    while (seq - atomic_load_explicit(& r->head, memory_order_acquire) >= PIPE_SLOTS)
+        sched_yield();
+    return r->data[seq % PIPE_SLOTS];
+}
+
+//Producer: hands the next chunk (length already set) to the consumer
+static publishChunk(chunkRing * r)
+{
+    atomic_store_explicit(& r->tail, atomic_load_explicit(& r->tail, memory_order_relaxed) + 1, memory_order_release);
+}
+
+//Producer: no more chunks follow
+static finishChunkRing(chunkRing * r)
+{
+    atomic_store_explicit(& r->finished, 1, memory_order_release);
+}
+
+//Consumer: waits for the next chunk and returns its length, or -1 when the producer has finished
+static int takeChunk(chunkRing * r, char ** data)
+{
+    unsigned head = atomic_load_explicit(& r->head, memory_order_relaxed);
+    while (1)
+    {
+        if (head != atomic_load_explicit(& r->tail, memory_order_acquire))
+        {
+            *data = r->data[head % PIPE_SLOTS];
+            return r->length[head % PIPE_SLOTS];
+        }
+        if (atomic_load_explicit(& r->finished, memory_order_acquire) && head == atomic_load_explicit(& r->tail, memory_order_acquire))
+            return -1;
+        sched_yield();
+    }
+}
+
+//Consumer: gives the chunk taken last back to the producer
+static releaseChunk(chunkRing * r)
+{
+    atomic_store_explicit(& r->head, atomic_load_explicit(& r->head, memory_order_relaxed) + 1, memory_order_release);
+}
+
+//Reads from given file until buf is full or end of file is reached; returns number of bytes read
+static int readFully(int fileFd, char * buf, int len)
+{
+    int total = 0;
+    while (total < len)
+    {
+        int n = read(fileFd, buf + total, len - total);
+        if (n <= 0)
+            break;
+        total += n;
+    }
+    return total;
+}
+
+//Reader stage of cpin: reads the source file into the chunk ring
+static void * cpinReader(void * arg)
+{
+    int sourceFd = *(int *) arg;
+    unsigned seq;
+    for (seq = 0; ; seq++)
+    {
+        char *chunk = waitForFreeChunk(& pipeRing, seq);
+        int nbytes = readFully(sourceFd, chunk, PIPE_CHUNK);
+        if (nbytes > 0)
+        {
+            pipeRing.length[seq % PIPE_SLOTS] = nbytes;
+            publishChunk(& pipeRing);
+        }
+        if (nbytes < PIPE_CHUNK)
+            break;
+    }
+    finishChunkRing(& pipeRing);
+    return 0;
+}
+
+//Waits until all data runs of this thread are written
+static waitForDataRuns()
+{
+    int i;
+    for (i = 0; i < DATA_RUN_SLOTS; i++)
+    {
+        ioWait(& dataRunPending[i]);
+    }
+}
+
+//Writes the contents of the open source file into the (already allocated) inode and persists the inode with its size
+//When pipelined, the source is read by a reader thread while this thread allocates and writes the blocks;
+//after a failure the remaining chunks are only drained so that the reader can finish
+//All-zero blocks are left as holes, except the last block of the file which fileSize() needs allocated
+//Returns 0 on success, -1 when the file system ran out of blocks
+static int writeFileData(int sourceFd, off_t size, int inodeNo, int pipelined)
+{
+	char *buf;
+	char chunk[PIPE_CHUNK];
+	pthread_t reader;
+	blockMapBuilder map;
+	inode new_inode;
+	int isSuccess = 0;
+	int nbytes;
+	int zeroBlocks = 0;
+	off_t fileBytes = 0;
+	readInode(inodeNo, & new_inode);
+	setAllocatedBitINode( & new_inode);
+	startBlockMap(& map, & new_inode);
+	//File blocks are placed in the allocation group of the directory the file is created in (current_inode)
+	setAllocationGroup(directoryGroup(& current_inode));
+	//Reserve indirect blocks and then the data blocks as contiguous runs, so file data is laid out sequentially
+	int nblocks = (size + blockSize - 1) / blockSize;
+	reserveBlocks(& indirectReservation, countIndirectBlocks(nblocks));
+	reserveBlocks(& dataReservation, nblocks);
+	if (pipelined)
+	{
+		resetChunkRing(& pipeRing);
+		//Without a reader thread this thread reads the source itself
+		if (pthread_create(& reader, 0, cpinReader, & sourceFd) != 0)
+			pipelined = 0;
+	}
+	while ((nbytes = pipelined ? takeChunk(& pipeRing, & buf) : readFully(sourceFd, buf = chunk, PIPE_CHUNK)) > 0)
+	{
+		int offset;
+		memset(buf + nbytes, 0, ((blockSize - (nbytes % blockSize)) % blockSize));
+		for (offset = 0; isSuccess == 0 && offset < nbytes; offset += blockSize)
+		{
+			if (isZeroBlock(buf + offset))
+			{
+				zeroBlocks++;
+				continue;
+			}
+			if ((isSuccess = addHoles(& map, zeroBlocks)) == 0)
+				isSuccess = writeToFile(buf + offset, & map);
+			zeroBlocks = 0;
+			if (isSuccess < 0)
+			{
+				progress(" cpin Failed\n");
+			}
+		}
+		if (isSuccess == 0)
+			fileBytes += nbytes;
+		if (pipelined)
+			releaseChunk(& pipeRing);
+		else if (isSuccess < 0)
+			break;
+	}
+	if (pipelined)
+		pthread_join(reader, 0);
+	if (isSuccess == 0 && zeroBlocks > 0)
+	{
+		memset(chunk, 0, blockSize);
+		if ((isSuccess = addHoles(& map, zeroBlocks - 1)) == 0)
+			isSuccess = writeToFile(chunk, & map);
+	}
+	//A partly written file keeps size 0, which fileSize() reads as its allocated blocks
+	setFileSize(& new_inode, isSuccess == 0 ? fileBytes : 0);
+	flushDataRun();
+	waitForDataRuns();
+	finishBlockMap(& map);
+	releaseReservation(& dataReservation);
+	releaseReservation(& indirectReservation);
+	writeInode(inodeNo, & new_inode);
+	return isSuccess;
+}
+
+//Copies the given source file into destination file in the V6filesystem
+static copyin(char * source, char * dest)
+{
+    char key[1000];
+    char *name;
+    struct stat sourceStat;
+    canonicalPath(dest, key, & name);
+	int sourceFd = open(source, O_RDONLY);
+	if (sourceFd < 0 || fstat(sourceFd, & sourceStat) < 0)
+	{
+        report("Cannot open the source file %s \n", source);
+        return;
+	}
+	int isFile ;
+	isFile=isFileAlreadyExist(key);
+	if (isFile > 0 ) 
+	{
+        setInode1asCurrent();
+        report("File name already exist \n");
+        close(sourceFd);
+	    return;
+	} 
+	else if (isFile == -2)
+	{
+        setInode1asCurrent();
+        report("one of the Directory in the given path not exist \n");
+        close(sourceFd);
+        return;
+	}
+	if (sourceStat.st_size > (off_t) maxFileBlocks * blockSize)
+	{
+        setInode1asCurrent();
+        report("Given file is larger than the maximum file size of %lld bytes \n", (long long) maxFileBlocks * blockSize);
+        close(sourceFd);
+        return;
+	}
+	int inodeNo = getFreeInode();
+	if (inodeNo > superblock.isize)
+	{
+		report(" \n Inode limit reached, no more files or directory can be created \n ");
+		close(sourceFd);
+		return;
+	}
+
+    if (writeFileNameinDir(inodeNo, name) < 0)
+    {
+        freeInodeNumber(inodeNo);
+        setInode1asCurrent();
+        close(sourceFd);
+        return;
+    }
+    setPathCacheEntry(key, current_inode_no, inodeNo);
+
+	int isSuccess = writeFileData(sourceFd, sourceStat.st_size, inodeNo, 1);
+	close(sourceFd);
+    if(isSuccess==0)
+    {
+        readFileInodeAddr(inodeNo);
+        readDirInodeAddr(getCurrentDirectoryInodeNo());
+        commandSucceeded(" Given File copied into V6FileSystem successfully \n");
+    }
+    else
+    {
+        report("Given file is partially written into the Filesystem till free data block exists \n");
+    }
+	setInode1asCurrent();
+}
+
+//Returns the inode number of given file in the current directory; 0 if not present
+static int getInodeNumber(char *path)
+{
+	dirIndex *index = getDirIndex(current_inode_no, & current_inode);
+	return lookupDirIndex(index, path);
+}
+
+//Cached result of resolving one path: parent directory and inode of its last component
+//parentInodeNo is 0 when a directory on the way is missing; inodeNo is 0 for a missing last component
+typedef struct pathCacheEntry
+{
+    char *path;
+    int parentInodeNo;
+    int inodeNo;
+    struct pathCacheEntry *next;
+}pathCacheEntry;
+
+//Path resolution cache, hashed on the canonical path string; bulk copy workers add entries under pathCacheLock
+static pathCacheEntry *pathCache[PATH_CACHE_HASH];
+static int pathCacheCount;
+static pthread_mutex_t pathCacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+//Hash of a canonical path
+static unsigned int hashPath(char * path)
+{
+    unsigned int h = 2166136261u;
+    while (*path)
+    {
+        h = (h ^ (unsigned char) *path++) * 16777619u;
+    }
+    return h % PATH_CACHE_HASH;
+}
+
+//Returns the cache entry of given canonical path; 0 if it is not cached
+static pathCacheEntry * findPathCacheEntry(char * path)
+{
+    pathCacheEntry *e;
+    for (e = pathCache[hashPath(path)]; e; e = e->next)
+    {
+        if (strcmp(e->path, path) == 0)
+            return e;
+    }
+    return 0;
+}
+
+//Drops all cached paths
+static invalidatePathCache()
+{
+    int i;
+    for (i = 0; i < PATH_CACHE_HASH; i++)
+    {
+        while (pathCache[i])
+        {
+            pathCacheEntry *e = pathCache[i];
+            pathCache[i] = e->next;
+            free(e->path);
+            free(e);
+        }
+    }
+    pathCacheCount = 0;
+}
+
+//Adds or updates the cache entry of given canonical path
+static setPathCacheEntry(char * path, int parentInodeNo, int inodeNo)
+{
+    pthread_mutex_lock(& pathCacheLock);
+    pathCacheEntry *e = findPathCacheEntry(path);
+    if (e == 0)
+    {
+        if (pathCacheCount >= PATH_CACHE_MAX)
+            invalidatePathCache();
+        e = malloc(sizeof(pathCacheEntry));
+        e->path = strdup(path);
+        e->next = pathCache[hashPath(path)];
+        pathCache[hashPath(path)] = e;
+        pathCacheCount++;
+    }
+    e->parentInodeNo = parentInodeNo;
+    e->inodeNo = inodeNo;
+    pthread_mutex_unlock(& pathCacheLock);
+}
+
+//Drops the entries of paths cached with a missing directory on the way
+static removeMissingDirPathCacheEntries()
+{
+    int i;
+    for (i = 0; i < PATH_CACHE_HASH; i++)
+    {
+        pathCacheEntry **pp = &pathCache[i];
+        while (*pp)
+        {
+            pathCacheEntry *e = *pp;
+            if (e->parentInodeNo == 0)
+            {
+                *pp = e->next;
+                free(e->path);
+                free(e);
+                pathCacheCount--;
+            }
+            else
+            {
+                pp = &e->next;
+            }
+        }
+    }
+}
+
+//Copies given path into key as /a/b/c and returns its number of components; lastName points to the last component in key
+static int canonicalPath(char * path, char * key, char ** lastName)
+{
+    char temp[1000];
+    char *token;
+    int n = 0;
+    strncpy(temp, path, sizeof(temp) - 1);
+    temp[sizeof(temp) - 1] = '\0';
+    key[0] = '\0';
+    *lastName = key;
+    for (token = strtok(temp, "/"); token; token = strtok(0, "/"))
+    {
+        strcat(key, "/");
+        *lastName = key + strlen(key);
+        strcat(key, token);
+        n++;
+    }
+    return n;
+}
+
+//Loads given directory inode as current inode
+static setCurrentDirectory(int inode_no)
+{
+    readInode(inode_no, & current_inode);
+    current_inode_no = inode_no;
+}
+
+//Resolves given path through the path cache, walking and caching each uncached prefix from the root
+//Current directory is set to the parent directory of the last component
+//Returns inode number of the last component, -1 if only the last component is missing, -2 if a directory on the way is missing
+static int resolvePath(char * path)
+{
+    char key[1000];
+    char *name;
+    int parentNo;
+    int n = canonicalPath(path, key, & name);
+    if (n == 0)
+    {
+        setCurrentDirectory(1);
+        return 1;
+    }
+    pathCacheEntry *e = findPathCacheEntry(key);
+    if (e)
+    {
+        if (e->parentInodeNo == 0)
+            return -2;
+        setCurrentDirectory(e->parentInodeNo);
+        return e->inodeNo > 0 ? e->inodeNo : -1;
+    }
+    if (n == 1)
+    {
+        parentNo = 1;
+    }
+    else
+    {
+        name[-1] = '\0';
+        parentNo = resolvePath(key);
+        name[-1] = '/';
+        if (parentNo > 0)
+        {
+            inode parent;
+            readInode(parentNo, & parent);
+            if (!isDirectory( & parent))
+                parentNo = -2;
+        }
+    }
+    if (parentNo < 0)
+    {
+        setPathCacheEntry(key, 0, 0);
+        return -2;
+    }
+    setCurrentDirectory(parentNo);
+    int inodeNo = getInodeNumber(name);
+    setPathCacheEntry(key, parentNo, inodeNo);
+    return inodeNo > 0 ? inodeNo : -1;
+}
+
+//Return inode number if the file/directory exist in filesystem; else returns negative numbers
+//Current directory is left at the parent directory of the last path component
+static int isFileAlreadyExist(char *fullPath)
+{
+    int inodeNumber = resolvePath(fullPath);
+    if (inodeNumber > 0)
+    {
+        progress(" exist \n");
+    }
+    else if (inodeNumber == -1)
+    {
+        progress(" Given File  not exist \n");
+    }
+    else if (!batchMode)
+    {
+        report("One of the Directory in %s not exist \n", fullPath);
+    }
+    return inodeNumber;
+}
+//Creates the new directory inside V6filesystem
+static mkdirV6(char * path)
+{
+    char key[1000];
+    char *name;
+    canonicalPath(path, key, & name);
+	int inodeNo = resolvePath(key);
+	if (inodeNo > 0)
+	{
+		report("Directory Already exist \n");
+		return;
+	}
+	else if (inodeNo == -2)
+	{
+		report("One of the Directory in %s not exist \n", key);
+		return;
+	}
+	inodeNo = getFreeInode();
+
+	if (inodeNo > superblock.isize)
+	{
+		report(" \n Inode limit reached, no more files or directory can be created \n ");
+		return;
+	}
+
+	inode new_inode;
+	readInode(inodeNo, & new_inode);
+	{
+		setAllocatedBitINode( & new_inode);
+
+		setDirectoryTypeFile( & new_inode);
+
+		dir dirData;
+		dirData.inode_no = inodeNo;
+		strcpy(dirData.file_name, ".");
+
+	if(	writeDirBlock(& dirData, & new_inode)==-1)
+    {
+        report( "  Given Directory not created \n");
+        resetAllocatedBitInode(& new_inode);
+        freeInodeNumber(inodeNo);
+        return;
+    }
+
+		dirData.inode_no = getCurrentDirectoryInodeNo();
+
+		strcpy(dirData.file_name, "..");
+
+		if(writeDirBlock(& dirData, & new_inode)==-1)
+        {
+              report( "  Given Directory not created \n");
+              //The block holding . is already taken
+              if (new_inode.addr[0] > 0)
+              {
+                  addFreeBlocks(new_inode.addr[0]);
+                  flushFreedBlocks();
+              }
+              resetAllocatedBitInode(& new_inode);
+              freeInodeNumber(inodeNo);
+                return;
+        }
+
+		writeInode(inodeNo, & new_inode);
+
+		writeFileNameinDir(inodeNo, name);
+		setPathCacheEntry(key, current_inode_no, inodeNo);
+		//Paths under the new directory may have been cached as missing
+		removeMissingDirPathCacheEntries();
+
+		readDirInodeAddr(inodeNo);
+		readDirInodeAddr(getCurrentDirectoryInodeNo());
+		readDirInodeAddr(1);
+		setInode1asCurrent();
+        commandSucceeded(" Given Directory created successfully \n");
+	}
+}
+
+//Returns current directory inode number
+static int getCurrentDirectoryInodeNo()
+{
+	dir tempdir;
+	readFromFS((off_t) blockSize * directoryBlock(& current_inode, 0), & tempdir, sizeof(dir));
+	return tempdir.inode_no;
+}
+
+//Write given filenames inside the directory data block and the directory's name index
+static writeFileNameinDir(int inode_no, char * path) 
+{
+	dir tempdir;
+	memset(& tempdir, 0, sizeof(dir));
+	tempdir.inode_no = inode_no;
+	strncpy(tempdir.file_name, path, sizeof(tempdir.file_name));
+	unsigned int oldAddr[8];
+	memcpy(oldAddr, current_inode.addr, sizeof(oldAddr));
+	dirIndex *index = getDirIndex(current_inode_no, & current_inode);
+	int isWritten = writeDirBlock(& tempdir, & current_inode);
+	//Directory got a new data block or turned hashed; persist its inode
+	if (memcmp(oldAddr, current_inode.addr, sizeof(oldAddr)) != 0)
+		writeInode(current_inode_no, & current_inode);
+	if (isWritten < 0)
+	{
+		report(" Directory is full, %s not added \n", path);
+		return -1;
+	}
+	index->hashed = isHashedDirectory(& current_inode);
+	addDirIndexEntry(index, tempdir.file_name, inode_no);
+	return 0;
+}
+
+//Sets root node as current inode
+static setInode1asCurrent()
+{
+    readInode(1, & current_inode);
+    current_inode_no = 1;
+}
+
+//Read existing initiazlised V6filesystem file
+//The image is opened by the first command of the session; the superblock, bitmaps, caches and journal state are
+//then kept in memory, so later commands only start again from the root directory. Returns -1 without a usable image
+//The geometry is taken from the super block first, as everything after it is read in blocks of the image
+static int readV6FS() 
+{
+	super_block sb;
+	if (imageOpen)
+	{
+		setInode1asCurrent();
+		return 0;
+	}
+	fd = open(imageFile, O_RDWR);
+	if (fd < 0)
+	{
+		report("V6FileSystem not found, use initfs first \n");
+		return -1;
+	}
+	memset(& sb, 0, sizeof(sb));
+	pread(fd, & sb, sizeof(sb), 512);
+	if (loadGeometry(& sb) < 0)
+	{
+		report("V6FileSystem not initialized \n");
+		close(fd);
+		return -1;
+	}
+	if (!journalOpened)
+		replayJournal(& sb);
+	if (useMmap && mappedImage == 0)
+		mapImage();
+	readInode(1, & current_inode);
+	current_inode_no = 1;
+	if (!isAllocatedInode( & current_inode)) 
+	{
+		report("V6FileSystem not initialized \n");
+		unmapImage();
+		invalidateBufferCache();
+		close(fd);
+		return -1;
+	}
+	readFromFS(512 * 1, & superblock, sizeof(super_block));
+	//Records the size taken from the image file, so that it is kept from now on
+	if (!wideFormat && superblock.fsize == 0)
+	{
+		superblock.fsize = fsBlocks;
+		superblock.fmod = 1;
+	}
+	if (!journalOpened)
+		startJournal();
+	journalOpened = 1;
+	if (inodeBitmap == 0)
+		buildInodeBitmap();
+	if (!blockBitmapBuilt)
+		buildBlockBitmap();
+	imageOpen = 1;
+	return 0;
+}
+
+//Closes V6FileSystem and drops everything kept in memory for it; the caller has synced it
+static closeImage()
+{
+	unmapImage();
+	invalidateBufferCache();
+	invalidateDirIndexes();
+	invalidatePathCache();
+	close(fd);
+	imageOpen = 0;
+	journalOpened = 0;
+	journalActive = 0;
+	blockBitmapBuilt = 0;
+	free(inodeBitmap);
+	inodeBitmap = 0;
+}
+
+#ifndef V6FS_LIBRARY
+//Prints the list of commands
+static showUsage()
+{
+    printf("Below are options:\n");
+    printf("    initfs <fsize> <total_num_of_inodes> [bitmap] [journal] [wide [block_size]]\n");
+    printf("    cpin <external_sourceFilePath> <destination_path>\n");
+    printf("    cpout <internal_sourceFilePath> <external_destPath>\n");
+    printf("    cpin-many <destination_directory> <external_sourceFile_or_pattern> ...\n");
+    printf("    cpout-many <internal_sourceDirectory> <external_destDirectory>\n");
+    printf("    read <FilePath> <offset> <length>\n");
+    printf("    cat <FilePath>\n");
+    printf("    mkdir <DirectoryPath>\n");
+    printf("    rm <FilePath>     \n");
+    printf("    rm -r <FileOrDirectoryPath>\n");
+    printf("    df\n");
+    printf("    sync\n");
+    printf("Or type q to exit \n");
+}
+
+//Volume of the fsaccess prompt, opened by the first command that needs it
+static V6Volume *volume;
+
+//Returns the volume of the prompt with the root as current directory; opens V6FileSystem on first use
+static V6Volume * promptVolume()
+{
+    if (volume == 0)
+        volume = v6Open(imageFile);
+    else
+        setInode1asCurrent();
+    return volume;
+}
+
+/**************************************************************************************
+* read <path> <offset> <len> and cat <path>: writes the given byte range of a file
+* to stdout (up to the end of the file when len is -1); only the blocks of the range
+* are read, each found with bmap(). In batch mode a newline is added when the data
+* does not end with one, so that the status line of the command starts on its own line
+* *************************************************************************************/
+static int readFileRange(char * path, off_t offset, off_t len)
+{
+    char block[MAX_BLOCK_SIZE];
+    char last = '\n';
+    ssize_t n;
+    V6File *file = v6OpenFile(volume, path, V6_READ);
+    if (file == 0)
+        return -1;
+    v6Seek(file, offset < 0 ? 0 : offset, SEEK_SET);
+    while (len != 0 && (n = v6Read(file, block, (len < 0 || len > blockSize) ? blockSize : len)) > 0)
+    {
+        fwrite(block, 1, n, stdout);
+        last = block[n - 1];
+        if (len > 0)
+            len -= n;
+    }
+    if (batchMode && last != '\n')
+        putchar('\n');
+    fflush(stdout);
+    v6Close(file);
+    return 0;
+}
+
+//Prints the block and inode usage of the volume
+static int showFreeSpace()
+{
+    V6VolumeInfo info;
+    if (v6Stat(volume, & info) < 0)
+        return -1;
+    printf(" Blocks: %u total, %u used, %u free \n", info.blocks, info.blocks - info.freeBlocks, info.freeBlocks);
+    printf(" Inodes: %d total, %d used, %d free \n", info.inodes, info.inodes - info.freeInodes, info.freeInodes);
+    printf(" Block size: %d bytes, %d bit block numbers \n", info.blockSize, info.addressBits);
+    printf(" Free blocks kept in: %s \n", info.freeBitmap ? "bitmap" : "free chain");
+    return 0;
+}
+
+//Checks the open transaction holds changes, which a later abortJournal() would drop
+static int journalPending()
+{
+    pthread_mutex_lock(& cacheLock);
+    int pending = journalActive && (countDirtyBuffers() > 0 || journalRevokeCount > 0 || freedBlockCount > 0);
+    pthread_mutex_unlock(& cacheLock);
+    return pending;
+}
+
+//A command reported done whose changes are still in the open journal transaction (group commit)
+typedef struct pendingCommand
+{
+    int lineNo;
+    char name[16];
+}pendingCommand;
+
+void main(int argc, char *argv[]) 
+{
+    
+    char input[MAX];
+    char* commandsArgv[256];
+    int res;
+    int i;
+    pendingCommand *pending = 0;
+    int pendingCount = 0, pendingCapacity = 0;
+    unsigned int commits;
+    int wantAsync = 1;
+    FILE *commands = stdin;
+    int lineNo = 0, commandCount = 0, failedCount = 0;
+    batchMode = 0;
+    for (i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-m"))
+            useMmap = 1;
+        else if (!strcmp(argv[i], "-s"))
+            wantAsync = 0;
+        else if (!strcmp(argv[i], "-g"))
+            groupCommit = 1;
+        else if (!strcmp(argv[i], "-f") && i + 1 < argc)
+        {
+            //Batch mode; "-f -" reads the commands from stdin
+            batchMode = 1;
+            groupCommit = 1;
+            i++;
+            if (strcmp(argv[i], "-") && (commands = fopen(argv[i], "r")) == 0)
+            {
+                printf("Cannot open the command file %s \n", argv[i]);
+                exit(1);
+            }
+        }
+    }
+    startIoEngine(wantAsync);
+    initializeBufferCache();
+    selectBitmapScan();
+    while(1)
+    {
+        // Printing command prompt
+        if (!batchMode)
+            printf(">>");
+        // Gets user input; end of input quits like q
+        if (fgets(input, sizeof(input), commands) == 0)
+            strcpy(input, "q");
+        lineNo++;
+        {
+            int j=0;
+            input[strcspn(input, "\r\n")]='\0';
+            commandsArgv[j] = strtok(input, " \t" );
+
+            while( commandsArgv[j]!=NULL)
+            {
+                commandsArgv[++j]=strtok(NULL, " \t" );
+            }
+ 
+            if(commandsArgv[0]!=NULL && commandsArgv[0][0] != '#')
+            {
+            commandDone = 0;
+            journalDropped = 0;
+            commits = journalCommits;
+            // if user enters 'q', comeout of loop
+            res = strcmp(input,"q");
+            if (res == 0)
+            {
+                if (volume)
+                    v6CloseVolume(volume);
+                if (batchMode)
+                    printf("%d commands, %d failed \n", commandCount, failedCount);
+                else
+                    printf("Exiting from file system... \n");
+                break;
+            }
+            else
+            {
+                if(!strcmp(commandsArgv[0],"initfs") && j >= 3)
+                {
+                    progress("Initiating File System \n");
+                    int flags = 0, wideBlockSize = 0, k;
+                    for (k = 3; k < j; k++)
+                    {
+                        if (!strcmp(commandsArgv[k], "bitmap"))
+                            flags |= V6_BITMAP;
+                        if (!strcmp(commandsArgv[k], "journal"))
+                            flags |= V6_JOURNAL;
+                        //wide takes an optional block size, WIDE_BLOCK_SIZE by default
+                        if (!strcmp(commandsArgv[k], "wide"))
+                        {
+                            wideBlockSize = WIDE_BLOCK_SIZE;
+                            if (k + 1 < j && isdigit((unsigned char) commandsArgv[k + 1][0]))
+                                wideBlockSize = atoi(commandsArgv[++k]);
+                        }
+                    }
+                    if (volume)
+                        v6CloseVolume(volume);
+                    if (wideBlockSize)
+                        volume = v6CreateWide(imageFile, strtoul(commandsArgv[1], 0, 10), atoi(commandsArgv[2]), wideBlockSize, flags);
+                    else
+                        volume = v6Create(imageFile, atoi(commandsArgv[1]), atoi(commandsArgv[2]), flags);
+                }
+                else if(!strcmp(commandsArgv[0],"cpin") && j >= 3)
+                {
+                    progress("Copying external file into filesystem \n");
+                    if (promptVolume())
+                        commandDone = v6CopyIn(volume, commandsArgv[1], commandsArgv[2]) == 0;
+                }
+                else if(!strcmp(commandsArgv[0],"cpout") && j >= 3)
+                {
+                    progress("Copying out a file from filesystem \n");
+                    if (promptVolume())
+                        commandDone = v6CopyOut(volume, commandsArgv[1], commandsArgv[2]) == 0;
+                }
+                else if(!strcmp(commandsArgv[0],"cpin-many") && j >= 3)
+                {
+                    progress("Copying external files into filesystem \n");
+                    if (promptVolume())
+                        commandDone = v6CopyInMany(volume, commandsArgv[1], & commandsArgv[2]) == 0;
+                }
+                else if(!strcmp(commandsArgv[0],"cpout-many") && j >= 3)
+                {
+                    progress("Copying out files of a directory from filesystem \n");
+                    if (promptVolume())
+                        commandDone = v6CopyOutMany(volume, commandsArgv[1], commandsArgv[2]) == 0;
+                }
+                else if(!strcmp(commandsArgv[0],"read") && j >= 4)
+                {
+                    if (promptVolume())
+                        commandDone = readFileRange(commandsArgv[1], atoll(commandsArgv[2]), atoll(commandsArgv[3])) == 0;
+                }
+                else if(!strcmp(commandsArgv[0],"cat") && j >= 2)
+                {
+                    if (promptVolume())
+                        commandDone = readFileRange(commandsArgv[1], 0, -1) == 0;
+                }
+                else if(!strcmp(commandsArgv[0],"mkdir") && j >= 2)
+                {
+                    progress("Creating directory inside file system \n");
+                    if (promptVolume())
+                        commandDone = v6Mkdir(volume, commandsArgv[1]) == 0;
+                }
+                else if(!strcmp(commandsArgv[0],"rm") && j >= 2)
+                {
+                    progress("Deleting a file from filesystem \n");
+                    if (promptVolume())
+                    {
+                        if (j >= 3 && !strcmp(commandsArgv[1], "-r"))
+                            commandDone = v6RemoveTree(volume, commandsArgv[2]) == 0;
+                        else
+                            commandDone = v6Unlink(volume, commandsArgv[1]) == 0;
+                    }
+
+                }
+                else if(!strcmp(commandsArgv[0],"df"))
+                {
+                    if (promptVolume())
+                        commandDone = showFreeSpace() == 0;
+                }
+                else if(!strcmp(commandsArgv[0],"sync"))
+                {
+                    progress("Writing cached data into filesystem \n");
+                    if (volume)
+                        v6Sync(volume);
+                    commandDone = 1;
+                }
+                else if (batchMode)
+                {
+                    printf("Unknown command or missing arguments: %s \n", commandsArgv[0]);
+                }
+                else
+                {
+                    printf("Please enter valid input \n");
+                    showUsage();
+                }
+                //Persist the super block and all the blocks modified by this command
+                syncFS();
+                //Commands reported done since the last commit are lost when the journal drops the transaction
+                if (journalCommits != commits)
+                    pendingCount = 0;
+                for (i = 0; journalDropped && i < pendingCount; i++)
+                {
+                    if (batchMode)
+                        printf("%d %s FAILED (dropped by line %d) \n", pending[i].lineNo, pending[i].name, lineNo);
+                    failedCount++;
+                }
+                if (journalDropped)
+                    pendingCount = 0;
+                commandCount++;
+                if (!commandDone)
+                    failedCount++;
+                if (batchMode)
+                    printf("%d %s %s \n", lineNo, commandsArgv[0], commandDone ? "ok" : "FAILED");
+                if (commandDone && journalPending())
+                {
+                    if (pendingCount == pendingCapacity)
+                    {
+                        pendingCapacity = pendingCapacity ? pendingCapacity * 2 : 64;
+                        pending = realloc(pending, pendingCapacity * sizeof(pendingCommand));
+                    }
+                    pending[pendingCount].lineNo = lineNo;
+                    strncpy(pending[pendingCount].name, commandsArgv[0], sizeof(pending[pendingCount].name) - 1);
+                    pending[pendingCount].name[sizeof(pending[pendingCount].name) - 1] = 0;
+                    pendingCount++;
+                }
+                }
+            }
+        }
+    }
+    if (commands != stdin)
+        fclose(commands);
+    exit(batchMode && failedCount > 0);
+}
+#endif
+
+//Reads directory data block of given directory inode
+static readDirInodeAddr(int inode_number) 
+{
+    if (batchMode)
+        return;
+    report(" Displaying the contents of Directory with I_node no %d \n",inode_number);
+	int i;
+	inode node;
+	readInode(inode_number, & node);
+	report(" /n -- Inode no %d --/n", inode_number);
+	report(" inode flags isDirec %d , isAlloc %d , isLarge %d ", isAllocatedInode( & node), isDirectory( & node), isLargeFile( & node));
+	report("/n Address array");
+	for (i = 0; i < 8; i++) 
+	{
+		report(" \n array[%d] is %u \n", i, node.addr[i]);
+		int size = 0;
+		int count = 0;
+		while (size < blockSize && i == 0) 
+		{
+			dir tempdir;
+			readFromFS(((off_t) blockSize * directoryBlock(& node, 0)) + size, & tempdir, sizeof(dir));
+			count++;
+			report(" bytes read %d ,  Directory inode_no %d , file name is %s \n ", (int) sizeof(dir), tempdir.inode_no, tempdir.file_name);
+			size += 16;
+		}
+		report(" No of dir %d \n", count);
+	}
+}
+
+//Reads content of given inode
+static readFileInodeAddr(int inode_number)
+{
+    if (batchMode)
+        return;
+    int i;
+    inode node;
+    readInode(inode_number, & node);
+    report(" /n -- Inode no %d --/n", inode_number);
+    report(" inode flags isDirec %d , isAlloc %d , isLarge %d ", isAllocatedInode( & node), isDirectory( & node), isLargeFile( & node));
+    report("/n Address array");
+    for (i = 0; i < 8; i++)
+    {
+        report(" \n array[%d] is %u \n", i, node.addr[i]);
+    }
+}
+
+//Initializes super block of V6FileSystem and the free blocks; the inode blocks of the new image are already zero
+//The geometry (setGeometry()) is set by the caller; a wide V6FileSystem records it in the 32 bit fields
+static initializeSuperBlock(unsigned int totalBlocks, int no_of_Inodes, int useBitmap, int useJournal)
+{
+	memset(& superblock, 0, sizeof(super_block));
+	superblock.isize = no_of_Inodes;
+	superblock.fmod = 1;
+	int no_Of_Inodes_Blocks = no_of_Inodes / inodesPerBlock;
+	if (no_of_Inodes % inodesPerBlock > 0) 
+	{
+		no_Of_Inodes_Blocks++;
+	}
+	unsigned int freeNodeStartPoint = no_Of_Inodes_Blocks + 2;
+	if (useJournal && totalBlocks / 8 < NBUF)
+	{
+		report(" V6FileSystem too small for a journal, created without one \n");
+		useJournal = 0;
+	}
+	//Chain holders are free blocks that get reused for file data outside the journal, so a journaled
+	//V6FileSystem keeps its free blocks in the on-disk bitmap; the free chain only holds 16 bit block numbers
+	if (useJournal || wideFormat)
+		useBitmap = 1;
+	bitmapStart = 0;
+	journalStart = 0;
+	if (useBitmap)
+	{
+		bitmapStart = freeNodeStartPoint;
+		freeNodeStartPoint += bitmapBlockCount(totalBlocks);
+	}
+	if (useJournal)
+	{
+		journalStart = freeNodeStartPoint;
+		superblock.journalSize = (totalBlocks / 8 < JOURNAL_BLOCKS) ? totalBlocks / 8 : JOURNAL_BLOCKS;
+		freeNodeStartPoint += superblock.journalSize;
+	}
+	if (wideFormat)
+	{
+		superblock.wideMagic = WIDE_MAGIC;
+		superblock.blockSize = blockSize;
+		superblock.blocks = totalBlocks;
+		superblock.bitmapBlock = bitmapStart;
+		superblock.journalBlock = journalStart;
+	}
+	else
+	{
+		superblock.fsize = totalBlocks;
+		superblock.bitmap = bitmapStart;
+		superblock.journal = journalStart;
+	}
+	initializeFreeBlocks(totalBlocks, freeNodeStartPoint);
+}
+//Initialize the free blocks (from freeNodeStartPoint up to totalBlocks) in the free-block bitmap and persist them:
+//as the on-disk bitmap, or as the V6 free chain written one whole block per FREE_WINDOW blocks by syncFreeChain()
+//With an on-disk bitmap the V6 free chain stays empty, so tools that only know the chain see no free blocks
+static initializeFreeBlocks(unsigned int totalBlocks, unsigned int freeNodeStartPoint)
+{
+	unsigned int i;
+	allocateBlockBitmap();
+	memset(freeWindowDirty, 0, sizeof(freeWindowDirty));
+	memset(windowHolder, 0, sizeof(windowHolder));
+	for (i = freeNodeStartPoint; i < totalBlocks; i++)
+	{
+		blockBitmap[i / 64] &= ~(1ULL << (i % 64));
+	}
+	blockBitmapBuilt = 1;
+	buildAllocGroups();
+	if (bitmapStart)
+	{
+		writeIntoFS((off_t) blockSize * bitmapStart, blockBitmap, bitmapBlockCount(totalBlocks) * blockSize);
+		blockBitmapDirty = 0;
+		return;
+	}
+	chainInWindowFormat = 0;
+	blockBitmapDirty = 1;
+	syncFreeChain();
+}
+//Writes the data block depends on the isDir values
+//if isDir = 1, write the given data as a directory content
+//else, writes it as a plain file block
+static int writeBlock(void * data, off_t offset, int isDir) 
+{
+	int size = 0;
+	buffer *bp;
+	if (isDir == 1) 
+	{
+		bp = readBuffer(offset / blockSize);
+		dir *entries = (dir *) bp->data;
+		while (size < blockSize && entries[size / sizeof(dir)].inode_no > 0) 
+		{
+			size += sizeof(dir);
+		}
+		if (size < blockSize) 
+		{
+			memcpy(& entries[size / sizeof(dir)], data, sizeof(dir));
+			releaseDirtyBuffer(bp);
+		} 
+		else 
+		{
+			releaseBuffer(bp);
+			return -1;
+		}
+	} 
+	else 
+	{
+		bp = getBuffer(offset / blockSize);
+		memcpy(bp->data, data, blockSize);
+		releaseDirtyBuffer(bp);
+	}
+	return 1;
+}
+
+//Add given free block into the batch of freed blocks
+static addFreeBlocks(unsigned int freeBlockNo)
+{
+    if (freedBlockCount == freedBlockCapacity)
+    {
+        freedBlockCapacity = freedBlockCapacity ? freedBlockCapacity * 2 : 1024;
+        freedBlocks = realloc(freedBlocks, freedBlockCapacity * sizeof(unsigned int));
+    }
+    freedBlocks[freedBlockCount++] = freeBlockNo;
+}
+
+static int compareBlockNumbers(const void * a, const void * b)
+{
+    unsigned int x = *(const unsigned int *) a, y = *(const unsigned int *) b;
+    return (x > y) - (x < y);
+}
+
+//Sorts the batch of freed blocks and marks them free group by group; cached copies of the blocks are dropped
+//so that data of removed files is not written back. The free blocks are persisted by syncFS() at the end of the command
+//With the journal the blocks stay in use until the transaction freeing them commits, so that no new data
+//is written into them while committed metadata may still point to them
+static flushFreedBlocks()
+{
+    int i;
+    if (freedBlockCount == 0)
+        return;
+    qsort(freedBlocks, freedBlockCount, sizeof(unsigned int), compareBlockNumbers);
+    for (i = 0; i < freedBlockCount && !mappedImage; i++)
+    {
+        forgetBuffer(freedBlocks[i]);
+    }
+    if (!journalActive)
+        releaseFreedBlocks();
+}
+
+//Marks the (sorted) batch of freed blocks free and empties it
+static releaseFreedBlocks()
+{
+    markBlocksFree(freedBlocks, freedBlockCount);
+    freedBlockCount = 0;
+}
+
+//Checks given entry of an inode or indirect block is the number of a block of V6FileSystem;
+//0 is a hole and 65535 was left by an older version in unused entries of V6 images
+static int isBlockAddress(unsigned int blockNo)
+{
+    return blockNo > 0 && blockNo < fsBlocks;
+}
+
+//Frees all the addresses of single indirect block and also given block; And add them into free list 
+//Holes (entries 0) are skipped
+static removeBlock(unsigned int blockNo)
+{
+
+   unsigned int entries[MAX_INDIRECT_ENTRIES];
+   int i;
+   loadIndirectBlock(blockNo, entries);
+   for (i = 0; i < indirectEntries; i++)
+    {
+	if (isBlockAddress(entries[i]))
+	    addFreeBlocks(entries[i]);
+         }
+	 addFreeBlocks(blockNo);
+}
+
+//Frees all the addresses of given double indirect block and add it into free list
+static removeDoubleIndirect(unsigned int blockNo)
+{
+    unsigned int entries[MAX_INDIRECT_ENTRIES];
+    int i=0;
+	if(isBlockAddress(blockNo))
+	{
+	    loadIndirectBlock(blockNo, entries);
+	    prefetchIndirectEntries(entries, 0, PREFETCH_AHEAD);
+	    for (i = 0; i < doubleIndirectEntries; i++)
+	    {
+            prefetchIndirectEntries(entries, i + PREFETCH_AHEAD, 1);
+            if (isBlockAddress(entries[i]))
+                removeBlock(entries[i]);
+	    }
+         addFreeBlocks(blockNo);
+	}	
+}
+
+//Frees all the double indirect blocks below given triple indirect block with their addresses and the block itself
+static removeTripleIndirect(unsigned int blockNo)
+{
+    unsigned int entries[MAX_INDIRECT_ENTRIES];
+    int i;
+	if(isBlockAddress(blockNo))
+	{
+	    loadIndirectBlock(blockNo, entries);
+	    for (i = 0; i < doubleIndirectEntries; i++)
+	    {
+            removeDoubleIndirect(entries[i]);
+	    }
+         addFreeBlocks(blockNo);
+	}
+}
+
+//Deletion of large file
+static removeLargeFie(inode * i_node)
+{
+    int i;
+    prefetchIndirectEntries(i_node->addr, 0, 8);
+    if (tripleIndirect)
+        removeTripleIndirect(i_node->addr[7]);
+    removeDoubleIndirect(i_node->addr[singleSlots]);
+    for (i = 0; i < singleSlots; i++)
+    {
+        if (isBlockAddress(i_node->addr[i]))
+	        removeBlock(i_node->addr[i]);
+    }
+    resetLargeFileBitInode(i_node);
+}
+
+//Removes file name entry from the directory data block; a hashed directory finds the entry by its name
+static removeFileNameinDir(int inode_no, char * name)
+{
+        int i,j;
+        dirIndex *index = getDirIndex(current_inode_no, & current_inode);
+        if (index->hashed)
+        {
+              removeHashedEntry(& current_inode, name);
+              return;
+        }
+        for (i = 0; i < 8; i++)
+        {
+              if (current_inode.addr[i] == 0)
+                  continue;
+              buffer *bp = readBuffer(current_inode.addr[i]);
+              dir *entries = (dir *) bp->data;
+              for (j = 0; j < (int) (blockSize / sizeof(dir)); j++)
+             {
+                 if (entries[j].inode_no == inode_no)
+                    {
+                       removeDirIndexEntry(index, entries[j].file_name);
+                       entries[j].inode_no = 0;
+		       strcpy(entries[j].file_name,"");
+		       releaseDirtyBuffer(bp);
+                      return;
+                    }
+             }
+              releaseBuffer(bp);
+      }
+    return 0;
+}
+
+//Removes file from v6filesystem of given inode
+static rmfile(  inode *i_node)
+{
+    int i=0;
+	if(isLargeFile(i_node)==1)
+	{	
+		removeLargeFie(i_node);
+	}	
+	else
+	{
+  		for (i = 0; i < 8; i++)
+		{		
+			if (isBlockAddress(i_node->addr[i]))
+				addFreeBlocks(i_node->addr[i]);
+		}
+	}
+    resetAllocatedBitInode(i_node);
+        for(i=0;i<8;i++)
+        {
+            i_node->addr[i] =0;
+        }
+    setFileSize(i_node, 0);
+}
+
+//Removes the given file from v6filesystem using given file path
+static removeFileDir(char * path)
+{
+    inode new_inode;
+    int i_node_no;
+    char key[1000];
+    char *name;
+    canonicalPath(path, key, & name);
+    i_node_no=isFileAlreadyExist(key);
+	if(i_node_no>0)
+	{
+		 readInode(i_node_no, & new_inode);
+		 if(isDirectory(&new_inode))
+		 {
+		 	report("Given file is the directory, use rm -r to remove a directory \n");
+			
+		 }
+		 else
+		 {
+		 	rmfile(&new_inode);
+			flushFreedBlocks();
+			freeInodeNumber(i_node_no);
+			removeFileNameinDir(i_node_no, name);
+			setPathCacheEntry(key, current_inode_no, 0);
+        writeInode(i_node_no, & new_inode);
+
+			readDirInodeAddr(getCurrentDirectoryInodeNo());
+			setInode1asCurrent();
+			commandSucceeded("Given file removed from the V6FileSystem successfully \n");
+        }
+	}
+	else
+	{
+		report("Given file or directory not exist %s \n",path);
+	}
+}
+
+//Frees given inode and its blocks; a directory has everything below it freed first
+//Freed blocks are only collected; the caller flushes them with flushFreedBlocks()
+//Returns -1 when the journal dropped the changes on the way (nothing is freed then)
+static int removeInode(int inode_no)
+{
+    inode node;
+    readInode(inode_no, & node);
+    if (isDirectory(& node))
+    {
+        if (removeDirectoryContents(inode_no, & node) < 0)
+            return -1;
+        dropDirIndex(inode_no);
+    }
+    rmfile(& node);
+    writeInode(inode_no, & node);
+    freeInodeNumber(inode_no);
+    return 0;
+}
+
+//Removes every file and directory listed in given directory except . and ..; the entries themselves are left,
+//the directory blocks are freed with the directory
+//With the journal each entry is removed from the directory right after what it names, as rm does, so that
+//V6FileSystem is consistent between entries and a large tree is committed in several transactions
+static int removeDirectoryContents(int dirInodeNo, inode * dirInode)
+{
+    dir *entries;
+    int i, j, count;
+    int nblocks = fileExtent(dirInode);
+    if (journalActive)
+    {
+        entries = collectDirEntries(dirInode, 0, nblocks, & count);
+        for (i = 0; i < count; i++)
+        {
+            if (removeInode(entries[i].inode_no) < 0)
+                break;
+            current_inode_no = dirInodeNo;
+            readInode(dirInodeNo, & current_inode);
+            removeFileNameinDir(entries[i].inode_no, entries[i].file_name);
+            if (journalSafePoint() < 0)
+                break;
+        }
+        free(entries);
+        return (i < count) ? -1 : 0;
+    }
+    entries = malloc(blockSize);
+    for (i = 0; i < nblocks; i++)
+    {
+        unsigned int blockNo = directoryBlock(dirInode, i);
+        if (blockNo == 0)
+            continue;
+        readFromFS((off_t) blockNo * blockSize, entries, blockSize);
+        for (j = 0; j < (int) (blockSize / sizeof(dir)); j++)
+        {
+            if (entries[j].inode_no == 0 || !strcmp(entries[j].file_name, ".") || !strcmp(entries[j].file_name, ".."))
+                continue;
+            removeInode(entries[j].inode_no);
+        }
+    }
+    free(entries);
+    return 0;
+}
+
+//Removes the given directory with everything below it (rm -r); a plain file is removed as by rm
+//All blocks of the subtree are freed in one sorted batch (with the journal, one per transaction)
+static removeTree(char * path)
+{
+    char key[1000];
+    char *name;
+    int i_node_no;
+    canonicalPath(path, key, & name);
+    i_node_no = isFileAlreadyExist(key);
+    if (i_node_no <= 0)
+    {
+        report("Given file or directory not exist %s \n", path);
+        return;
+    }
+    if (i_node_no == 1)
+    {
+        report("The root directory cannot be removed \n");
+        return;
+    }
+    inode node;
+    readInode(i_node_no, & node);
+    if (!isDirectory(& node))
+    {
+        removeFileDir(path);
+        return;
+    }
+    int parent = current_inode_no;
+    if (removeInode(i_node_no) < 0)
+    {
+        invalidatePathCache();
+        setInode1asCurrent();
+        return;
+    }
+    flushFreedBlocks();
+    current_inode_no = parent;
+    readInode(parent, & current_inode);
+    removeFileNameinDir(i_node_no, name);
+    //Cached paths below the directory are gone with it
+    invalidatePathCache();
+    setInode1asCurrent();
+    commandSucceeded("Given directory removed from the V6FileSystem successfully \n");
+}
+
+/**************************************************************************************
+*This function returns whole inode structure when inode number is given as an argument
+ **************************************************************************************/
+static inode getInodeInfoFromInodeNum(int inode_no)
+{
+    inode new_inode;
+    readInode(inode_no, & new_inode);
+    return new_inode;
+}
+
+/********************************************************************************************
+ * Appends a data block number to the block map being collected for cpout
+ *********************************************************************************************/
+static appendBlock(blockList * list, unsigned int blockNo)
+{
+    if (list->count == list->capacity)
+    {
+        list->capacity = list->capacity ? list->capacity * 2 : 64;
+        list->blocks = realloc(list->blocks, sizeof(unsigned int) * list->capacity);
+    }
+    list->blocks[list->count++] = blockNo;
+}
+
+/********************************************************************************************
+ * Position of cpout in the chunk ring: the reads of chunk copyFillSeq are being queued, the chunk
+ * before it may still have reads in flight; older chunks are handed to the writer thread
+ *********************************************************************************************/
+static unsigned copyFillSeq;
+static int copyFillCount;
+static off_t copySkip;
+static __thread int copyPipelined;
+
+/********************************************************************************************
+ * Hands the chunks before copyFillSeq to the writer thread once their reads have completed
+ *********************************************************************************************/
+static publishCopyChunks()
+{
+    unsigned seq;
+    for (seq = atomic_load_explicit(& pipeRing.tail, memory_order_relaxed); seq != copyFillSeq; seq++)
+    {
+        ioWait(& pipeRing.pending[seq % PIPE_SLOTS]);
+        publishChunk(& pipeRing);
+    }
+}
+
+/********************************************************************************************
+ * Closes the chunk being filled and hands every staged block to the writer thread
+ *********************************************************************************************/
+static flushCopyStages()
+{
+    if (!copyPipelined)
+        return;
+    if (copyFillCount > 0)
+    {
+        pipeRing.length[copyFillSeq % PIPE_SLOTS] = copyFillCount * blockSize;
+        copyFillSeq++;
+        copyFillCount = 0;
+    }
+    publishCopyChunks();
+}
+
+/********************************************************************************************
+ * Queues the reads of count consecutive blocks starting at firstBlock into the chunk ring;
+ * waits for the writer thread when the ring is full
+ *********************************************************************************************/
+static stageRunForCopy(unsigned int firstBlock, int count)
+{
+    while (count > 0)
+    {
+        char *chunk = waitForFreeChunk(& pipeRing, copyFillSeq);
+        int n = PIPE_CHUNK / blockSize - copyFillCount;
+        if (copyFillCount == 0)
+        {
+            pipeRing.skip[copyFillSeq % PIPE_SLOTS] = copySkip;
+            copySkip = 0;
+        }
+        if (n > count)
+            n = count;
+        ioRead(chunk + ((size_t) copyFillCount * blockSize), (size_t) n * blockSize,
+               (off_t) firstBlock * blockSize, & pipeRing.pending[copyFillSeq % PIPE_SLOTS]);
+        copyFillCount += n;
+        firstBlock += n;
+        count -= n;
+        if (copyFillCount == PIPE_CHUNK / blockSize)
+        {
+            pipeRing.length[copyFillSeq % PIPE_SLOTS] = PIPE_CHUNK;
+            publishCopyChunks();
+            copyFillSeq++;
+            copyFillCount = 0;
+        }
+    }
+}
+
+/********************************************************************************************
+ * Writer stage of cpout: writes the chunks of the ring into output file
+ *********************************************************************************************/
+static void * cpoutWriter(void * arg)
+{
+    int fd_outputFile = *(int *) arg;
+    char *chunk;
+    int n;
+    while ((n = takeChunk(& pipeRing, & chunk)) >= 0)
+    {
+        off_t skip = pipeRing.skip[atomic_load_explicit(& pipeRing.head, memory_order_relaxed) % PIPE_SLOTS];
+        if (skip > 0)
+            lseek(fd_outputFile, skip, SEEK_CUR);
+        write(fd_outputFile, chunk, n);
+        releaseChunk(& pipeRing);
+    }
+    return 0;
+}
+
+/********************************************************************************************
+ * Copies count consecutive blocks of v6filesystem starting at firstBlock into output file
+ * with one copy_file_range (pread/write when the kernel cannot copy between these files);
+ * in a pipelined cpout the blocks are read into the chunk ring with many requests in flight
+ *********************************************************************************************/
+static copyRunIntoFile(int fd, unsigned int firstBlock, int count, int fd_outputFile)
+{
+    off_t offset = (off_t) firstBlock * blockSize;
+    size_t len = (size_t) count * blockSize;
+    if (mappedImage)
+    {
+        ensureImageSize(firstBlock + count - 1);
+        write(fd_outputFile, mappedImage + offset, len);
+        return;
+    }
+    if (copyPipelined)
+    {
+        stageRunForCopy(firstBlock, count);
+        return;
+    }
+    while (len > 0)
+    {
+        ssize_t n = copy_file_range(fd, & offset, fd_outputFile, 0, len, 0);
+        if (n <= 0)
+            break;
+        len -= n;
+    }
+    while (len > 0)
+    {
+        char cbuf[PIPE_CHUNK];
+        ssize_t n = pread(fd, cbuf, len < sizeof(cbuf) ? len : sizeof(cbuf), offset);
+        if (n <= 0)
+            break;
+        write(fd_outputFile, cbuf, n);
+        offset += n;
+        len -= n;
+    }
+}
+
+/********************************************************************************************
+ * Leaves count blocks of the output file of cpout unwritten, recreating a hole of the file;
+ * in a pipelined cpout the chunk being filled is closed and the writer skips the hole before the next one
+ *********************************************************************************************/
+static skipHoleInFile(int fd_outputFile, int count)
+{
+    if (copyPipelined)
+    {
+        flushCopyStages();
+        copySkip += (off_t) count * blockSize;
+    }
+    else
+        lseek(fd_outputFile, (off_t) count * blockSize, SEEK_CUR);
+}
+
+/********************************************************************************************
+ * Writes the given block map into output file, coalescing physically adjacent blocks into runs
+ * and consecutive holes (block 0) into one hole of the output file
+ * When keepLastRun is set, a trailing run of data blocks shorter than an indirect block is kept in the list
+ * so that it can grow with the next blocks; longer runs and holes are written at once, so each call is
+ * bounded by the blocks it was given
+ *********************************************************************************************/
+static copyoutBlockRuns(int fd_outputFile, blockList * list, int keepLastRun)
+{
+    int i = 0;
+    flushDataRun();
+    ioWait(0);
+    while (i < list->count)
+    {
+        int count = 1;
+        int isHole = (list->blocks[i] == 0);
+        while (i + count < list->count && list->blocks[i + count] == (isHole ? 0 : list->blocks[i] + count))
+        {
+            count++;
+        }
+        if (keepLastRun && i + count == list->count && !isHole && count < indirectEntries)
+        {
+            memmove(list->blocks, list->blocks + i, sizeof(unsigned int) * count);
+            list->count = count;
+            return;
+        }
+        if (isHole)
+            skipHoleInFile(fd_outputFile, count);
+        else
+            copyRunIntoFile(fd, list->blocks[i], count, fd_outputFile);
+        i += count;
+    }
+    flushCopyStages();
+    list->count = 0;
+}
+
+/********************************************************************************************
+ * Starts reading given block in the background: into the buffer cache with an asynchronous
+ * I/O engine, otherwise into the page cache
+ *********************************************************************************************/
+static prefetchBlock(unsigned int blockNo)
+{
+    if (!isBlockAddress(blockNo))
+        return;
+    if (mappedImage)
+        madvise(mappedImage + (((off_t) blockNo * blockSize) & ~((off_t) getpagesize() - 1)), blockSize, MADV_WILLNEED);
+    else if (io->isAsync)
+    {
+        pthread_mutex_lock(& cacheLock);
+        buffer *bp = getBuffer(blockNo);
+        if (!bp->isValid)
+            queueBufferRead(bp);
+        releaseBuffer(bp);
+        pthread_mutex_unlock(& cacheLock);
+    }
+    else
+        posix_fadvise(fd, (off_t) blockNo * blockSize, blockSize, POSIX_FADV_WILLNEED);
+}
+
+/********************************************************************************************
+ * Prefetches the indirect blocks listed in entries from index first on; holes are skipped
+ *********************************************************************************************/
+static prefetchIndirectEntries(unsigned int entries[], int first, int count)
+{
+    int i;
+    for (i = first; i < first + count && i < indirectEntries; i++)
+    {
+        prefetchBlock(entries[i]);
+    }
+}
+
+/********************************************************************************************
+ * Loads all indirectEntries block numbers of an indirect block with one block read
+ *********************************************************************************************/
+static loadIndirectBlock(unsigned int blockNo, unsigned int entries[])
+{
+    int i;
+    buffer *bp = readBuffer(blockNo);
+    for (i = 0; i < indirectEntries; i++)
+    {
+        entries[i] = getBlockAddress(bp->data, i);
+    }
+    releaseBuffer(bp);
+}
+
+/********************************************************************************************
+ * Appends the data blocks of one single indirect block, at most remaining of them, to the list;
+ * holes are appended as block 0. Returns the number of blocks appended
+ *********************************************************************************************/
+static int appendIndirectBlock(blockList * list, unsigned int entries[], int remaining)
+{
+    int j;
+    for(j=0;j<indirectEntries && j<remaining;j++)
+    {
+        appendBlock(list, entries[j]);
+    }
+    return j;
+}
+
+/**************************************************************************************
+* Returns entry i of given indirect block
+* *************************************************************************************/
+static unsigned int readIndirectEntry(unsigned int indirectBlock, int i)
+{
+    unsigned char entry[sizeof(unsigned int)];
+    readFromFS((off_t) indirectBlock * blockSize + i * addrSize, entry, addrSize);
+    return getBlockAddress(entry, 0);
+}
+
+/**************************************************************************************
+* Returns single indirect block number index of a large file, 0 for a hole: addr[index] for
+* the first singleSlots, then entry index - singleSlots of the double indirect block and
+* after that an entry of a double indirect block found through the triple indirect block
+* *************************************************************************************/
+static unsigned int singleIndirectBlock(inode * node, int index)
+{
+    unsigned int doubleBlock = node->addr[singleSlots];
+    if (index < singleSlots)
+        return node->addr[index];
+    index -= singleSlots;
+    if (index >= doubleIndirectEntries)
+    {
+        index -= doubleIndirectEntries;
+        if (!tripleIndirect || index / doubleIndirectEntries >= doubleIndirectEntries || node->addr[7] == 0)
+            return 0;
+        doubleBlock = readIndirectEntry(node->addr[7], index / doubleIndirectEntries);
+        index %= doubleIndirectEntries;
+    }
+    if (doubleBlock == 0)
+        return 0;
+    return readIndirectEntry(doubleBlock, index);
+}
+
+/**************************************************************************************
+* Returns the data block holding logical block n of given file, 0 past the end of the file
+* For a large file the path is computed: entry n % indirectEntries of single indirect block
+* n / indirectEntries (singleIndirectBlock()), so at most three indirect blocks are read
+* *************************************************************************************/
+static unsigned int bmap(inode * node, off_t n)
+{
+    unsigned int single;
+    if (n < 0 || n >= maxFileBlocks)
+        return 0;
+    if (!isLargeFile(node))
+        return n < 8 ? node->addr[n] : 0;
+    single = singleIndirectBlock(node, n / indirectEntries);
+    if (single == 0)
+        return 0;
+    return readIndirectEntry(single, n % indirectEntries);
+}
+
+/**************************************************************************************
+* Returns the number of logical blocks of given file up to its last data block; holes in
+* the middle count, the last block of a file is always allocated. The indirect blocks are
+* scanned from the end, usually one per level
+* *************************************************************************************/
+static int fileExtent(inode * node)
+{
+    unsigned int entries[MAX_INDIRECT_ENTRIES];
+    unsigned int triple[MAX_INDIRECT_ENTRIES];
+    unsigned int single = 0;
+    int i, t, index = 0;
+    if (!isLargeFile(node))
+    {
+        for (i = 8; i > 0 && node->addr[i - 1] == 0; i--);
+        return i;
+    }
+    if (tripleIndirect && node->addr[7] != 0)
+    {
+        loadIndirectBlock(node->addr[7], triple);
+        for (t = doubleIndirectEntries; t > 0 && single == 0; t--)
+        {
+            if (triple[t - 1] == 0)
+                continue;
+            loadIndirectBlock(triple[t - 1], entries);
+            for (i = doubleIndirectEntries; i > 0 && entries[i - 1] == 0; i--);
+            if (i > 0)
+            {
+                single = entries[i - 1];
+                index = singleSlots + doubleIndirectEntries * t + i - 1;
+            }
+        }
+    }
+    if (single == 0 && node->addr[singleSlots] != 0)
+    {
+        loadIndirectBlock(node->addr[singleSlots], entries);
+        for (i = doubleIndirectEntries; i > 0 && entries[i - 1] == 0; i--);
+        if (i > 0)
+        {
+            single = entries[i - 1];
+            index = singleSlots + i - 1;
+        }
+    }
+    if (single == 0)
+    {
+        for (i = singleSlots; i > 0 && node->addr[i - 1] == 0; i--);
+        if (i == 0)
+            return 0;
+        single = node->addr[i - 1];
+        index = i - 1;
+    }
+    loadIndirectBlock(single, entries);
+    for (i = indirectEntries; i > 0 && entries[i - 1] == 0; i--);
+    return index * indirectEntries + i;
+}
+
+/**************************************************************************************
+* Returns the size of given file in bytes. size0/size1 hold its low 24 bits; the size lies
+* within the last block of fileExtent(), which gives the higher bits. A size of 0 (files
+* written before sizes were recorded, directories) stands for all the blocks of the file
+* The inode of a wide V6FileSystem holds the whole size
+* *************************************************************************************/
+static off_t fileSize(inode * node)
+{
+    if (wideFormat && node->size != 0)
+        return node->size;
+    off_t extent = (off_t) fileExtent(node) * blockSize;
+    if (wideFormat)
+        return extent;
+    off_t low = ((off_t) (unsigned char) node->size0 << 16) | node->size1;
+    if (low == 0)
+        return extent;
+    return extent - ((extent - low) & 0xffffff);
+}
+
+/**************************************************************************************
+* For small file - Gets file's inode as input & copies the file content to output file
+* *************************************************************************************/
+static copyoutSmallFile(int fd_outputFile, inode * inputFileinode)
+{
+    int i;
+    blockList list = {0};
+    int nblocks = fileExtent(inputFileinode);
+    for(i=0;i<nblocks;i++)
+    {
+        appendBlock(& list, inputFileinode->addr[i]);
+    }
+    copyoutBlockRuns(fd_outputFile, & list, 0);
+    free(list.blocks);
+         progress("File copied completely \n");
+}
+/**************************************************************************************
+* Copies out the data blocks below given double indirect block, at most remaining of them;
+* a missing double indirect block is a hole. Returns the number of blocks left to copy
+* *************************************************************************************/
+static int copyoutDoubleIndirect(int fd_outputFile, blockList * list, unsigned int doubleBlock, int remaining)
+{
+    int j;
+    unsigned int entries[MAX_INDIRECT_ENTRIES];
+    unsigned int doubleEntries[MAX_INDIRECT_ENTRIES];
+    if(doubleBlock==0)
+        memset(doubleEntries, 0, indirectEntries * sizeof(unsigned int));
+    else
+        loadIndirectBlock(doubleBlock, doubleEntries);
+    prefetchIndirectEntries(doubleEntries, 0, PREFETCH_AHEAD);
+    for(j=0;j<doubleIndirectEntries && remaining>0;j++)
+    {
+        if(doubleEntries[j]==0)
+            memset(entries, 0, indirectEntries * sizeof(unsigned int));
+        else
+            loadIndirectBlock(doubleEntries[j], entries);
+        prefetchIndirectEntries(doubleEntries, j + PREFETCH_AHEAD, 1);
+        remaining -= appendIndirectBlock(list, entries, remaining);
+        copyoutBlockRuns(fd_outputFile, list, remaining > 0);
+    }
+    return remaining;
+}
+
+/**************************************************************************************
+* For Large file - Gets file's inode as input & copies the file content to output file
+* Each indirect block is loaded once; the next one is prefetched while the data blocks of the current one are copied
+* The output is written in whole blocks; the caller truncates it to the size of the file
+* *************************************************************************************/
+static copyoutLargeFile(int fd_outputFile, inode * inputFileinode)
+{
+    int i;
+    blockList list = {0};
+    unsigned int entries[MAX_INDIRECT_ENTRIES];
+    int remaining = fileExtent(inputFileinode);
+    for(i=0;i<singleSlots && remaining>0;i++)
+    {
+        //Handling single indirect block; a missing one is a hole of indirectEntries blocks
+        if(inputFileinode->addr[i]==0)
+            memset(entries, 0, indirectEntries * sizeof(unsigned int));
+        else
+            loadIndirectBlock(inputFileinode->addr[i], entries);
+        prefetchBlock(inputFileinode->addr[i+1]);
+        remaining -= appendIndirectBlock(& list, entries, remaining);
+        copyoutBlockRuns(fd_outputFile, & list, remaining > 0);
+    }
+    //Handling double indirect block
+    if(remaining>0)
+        remaining = copyoutDoubleIndirect(fd_outputFile, & list, inputFileinode->addr[singleSlots], remaining);
+    //Handling triple indirect block, one double indirect block at a time
+    if(remaining>0 && tripleIndirect)
+    {
+        if(inputFileinode->addr[7]==0)
+            memset(entries, 0, indirectEntries * sizeof(unsigned int));
+        else
+            loadIndirectBlock(inputFileinode->addr[7], entries);
+        for(i=0;i<doubleIndirectEntries && remaining>0;i++)
+        {
+            remaining = copyoutDoubleIndirect(fd_outputFile, & list, entries[i], remaining);
+        }
+    }
+    copyoutBlockRuns(fd_outputFile, & list, 0);
+    free(list.blocks);
+    progress("File copied completely \n");
+}
+
+/**************************************************************************************
+* Copies source file from fileSystem to external path
+* *************************************************************************************/
+static copyout(char * source, char * dest)
+{
+    if (!batchMode)
+        report("cpout %s , %s", source, dest);
+    int fd_outputFile;
+    int sourceFileiNodeNum=isFileAlreadyExist(source);
+    if (sourceFileiNodeNum > 0) //Check source file exist in file system
+    {
+        progress("Source directory exist in the file system. Proceeding..\n");
+        fd_outputFile = open(dest, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        if (fd_outputFile < 0)
+        {
+            report(" %s: cannot create the output file \n", dest);
+            return;
+        }
+        //With an asynchronous I/O engine this thread reads the image while a writer thread writes the output file
+        pthread_t writer;
+        copyPipelined = io->isAsync && !mappedImage;
+        if (copyPipelined)
+        {
+            resetChunkRing(& pipeRing);
+            copyFillSeq = 0;
+            copyFillCount = 0;
+            copySkip = 0;
+            //Without a writer thread the blocks are written to the output file by this thread
+            if (pthread_create(& writer, 0, cpoutWriter, & fd_outputFile) != 0)
+                copyPipelined = 0;
+        }
+        inode new_node;
+        new_node = getInodeInfoFromInodeNum(sourceFileiNodeNum);
+        //check file is small or big
+        if(isLargeFile(&new_node)==0)
+        {
+            progress("source is a small file \n");
+            copyoutSmallFile(fd_outputFile,&new_node);
+        }
+        else
+        {
+            progress("Source file is large \n");
+            copyoutLargeFile(fd_outputFile,&new_node);
+        }
+        if (copyPipelined)
+        {
+            finishChunkRing(& pipeRing);
+            pthread_join(writer, 0);
+            copyPipelined = 0;
+        }
+        //Drops the padding of the last block and recreates a trailing hole
+        ftruncate(fd_outputFile, fileSize(& new_node));
+        close(fd_outputFile);
+        commandDone = 1;
+    }
+    else
+    {
+        report("Source directory doesnt exist in the file system. Cannot proceed..\n");
+    }
+}
+
+
+/**************************************************************************************
+* Bulk copy (cpin-many / cpout-many): one job per file, run by a pool of worker threads
+* sized to the number of cores; workers take the next job with an atomic counter
+* *************************************************************************************/
+typedef struct bulkJob
+{
+    char *hostPath;
+    char name[15];
+    int inodeNo;
+}bulkJob;
+
+static bulkJob *bulkJobs;
+static int bulkJobCount;
+static int bulkJobCapacity;
+static atomic_int bulkNextJob;
+static atomic_int bulkFailed;
+static int bulkDirInodeNo;
+static char bulkDirKey[1000];
+
+/**************************************************************************************
+* Adds a job for given host path and file name (truncated to 14 characters)
+* *************************************************************************************/
+static addBulkJob(char * hostPath, char * name, int inodeNo)
+{
+    if (bulkJobCount == bulkJobCapacity)
+    {
+        bulkJobCapacity = bulkJobCapacity ? bulkJobCapacity * 2 : 64;
+        bulkJobs = realloc(bulkJobs, sizeof(bulkJob) * bulkJobCapacity);
+    }
+    bulkJobs[bulkJobCount].hostPath = strdup(hostPath);
+    memset(bulkJobs[bulkJobCount].name, 0, sizeof(bulkJobs[bulkJobCount].name));
+    strncpy(bulkJobs[bulkJobCount].name, name, 14);
+    bulkJobs[bulkJobCount].inodeNo = inodeNo;
+    bulkJobCount++;
+}
+
+/**************************************************************************************
+* Drops all jobs
+* *************************************************************************************/
+static freeBulkJobs()
+{
+    int i;
+    for (i = 0; i < bulkJobCount; i++)
+    {
+        free(bulkJobs[i].hostPath);
+    }
+    bulkJobCount = 0;
+}
+
+/**************************************************************************************
+* Runs given worker on min(number of cores, number of jobs) threads and waits for all of them
+* *************************************************************************************/
+static runWorkerPool(void * (*worker)(void *))
+{
+    pthread_t threads[MAX_WORKERS];
+    int workers = sysconf(_SC_NPROCESSORS_ONLN);
+    int started = 0;
+    int i;
+    if (workers < 1)
+        workers = 1;
+    if (workers > MAX_WORKERS)
+        workers = MAX_WORKERS;
+    if (workers > bulkJobCount)
+        workers = bulkJobCount;
+    atomic_store(& bulkNextJob, 0);
+    atomic_store(& bulkFailed, 0);
+    for (i = 0; i < workers; i++)
+    {
+        if (pthread_create(& threads[started], 0, worker, 0) == 0)
+            started++;
+    }
+    if (started == 0 && bulkJobCount > 0)
+        worker(0);
+    for (i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], 0);
+    }
+}
+
+/**************************************************************************************
+* Copies one host file into the target directory of cpin-many; the directory is locked only
+* while the name is checked and added, the data is written without any directory lock
+* *************************************************************************************/
+static int importFile(bulkJob * job)
+{
+    struct stat sourceStat;
+    char key[1100];
+    int sourceFd = open(job->hostPath, O_RDONLY);
+    if (sourceFd < 0 || fstat(sourceFd, & sourceStat) < 0 || !S_ISREG(sourceStat.st_mode))
+    {
+        report(" %s: cannot open the source file \n", job->hostPath);
+        if (sourceFd >= 0)
+            close(sourceFd);
+        return -1;
+    }
+    if (sourceStat.st_size > (off_t) maxFileBlocks * blockSize)
+    {
+        report(" %s: larger than the maximum file size of %lld bytes \n", job->hostPath, (long long) maxFileBlocks * blockSize);
+        close(sourceFd);
+        return -1;
+    }
+    dirIndex *index = lockDirectory(bulkDirInodeNo);
+    if (lookupDirIndex(index, job->name) > 0)
+    {
+        unlockDirectory(index);
+        report(" %s: file name %s already exist \n", job->hostPath, job->name);
+        close(sourceFd);
+        return -1;
+    }
+    int inodeNo = getFreeInode();
+    if (inodeNo > superblock.isize)
+    {
+        unlockDirectory(index);
+        report(" %s: inode limit reached \n", job->hostPath);
+        close(sourceFd);
+        return -1;
+    }
+    if (writeFileNameinDir(inodeNo, job->name) < 0)
+    {
+        freeInodeNumber(inodeNo);
+        unlockDirectory(index);
+        close(sourceFd);
+        return -1;
+    }
+    unlockDirectory(index);
+    snprintf(key, sizeof(key), "%s/%s", bulkDirKey, job->name);
+    setPathCacheEntry(key, bulkDirInodeNo, inodeNo);
+    int isSuccess = writeFileData(sourceFd, sourceStat.st_size, inodeNo, 0);
+    close(sourceFd);
+    if (isSuccess == 0)
+        report(" %s -> %s \n", job->hostPath, key);
+    else
+        report(" %s -> %s partially written, free blocks exhausted \n", job->hostPath, key);
+    return isSuccess;
+}
+
+/**************************************************************************************
+* Worker of cpin-many; each file is copied under transactionLock so that journalSafePoint()
+* commits between files. Once the journal dropped a transaction the remaining jobs are skipped
+* *************************************************************************************/
+static void * cpinManyWorker(void * arg)
+{
+    int job, result;
+    (void) arg;
+    while ((job = atomic_fetch_add(& bulkNextJob, 1)) < bulkJobCount)
+    {
+        pthread_rwlock_rdlock(& transactionLock);
+        result = journalDropped ? -1 : importFile(& bulkJobs[job]);
+        pthread_rwlock_unlock(& transactionLock);
+        if (result < 0)
+            atomic_fetch_add(& bulkFailed, 1);
+        journalSafePoint();
+    }
+    return 0;
+}
+
+/**************************************************************************************
+* Resolves given internal directory for a bulk copy; returns its inode number, 0 if it is not a directory
+* *************************************************************************************/
+static int resolveBulkDirectory(char * path)
+{
+    char *name;
+    canonicalPath(path, bulkDirKey, & name);
+    int inodeNo = resolvePath(path);
+    setInode1asCurrent();
+    if (inodeNo <= 0)
+        return 0;
+    inode node = getInodeInfoFromInodeNum(inodeNo);
+    return isDirectory(& node) ? inodeNo : 0;
+}
+
+/**************************************************************************************
+* cpin-many: copies the given host files (shell patterns are expanded) into an internal directory
+* *************************************************************************************/
+static copyinMany(char * dest, char ** sources)
+{
+    glob_t found;
+    int i;
+    bulkDirInodeNo = resolveBulkDirectory(dest);
+    if (bulkDirInodeNo == 0)
+    {
+        report("Destination directory doesnt exist in the file system. Cannot proceed..\n");
+        return;
+    }
+    memset(& found, 0, sizeof(found));
+    for (i = 0; sources[i]; i++)
+    {
+        glob(sources[i], (i > 0 ? GLOB_APPEND : 0) | GLOB_NOCHECK, 0, & found);
+    }
+    for (i = 0; i < (int) found.gl_pathc; i++)
+    {
+        char *base = strrchr(found.gl_pathv[i], '/');
+        addBulkJob(found.gl_pathv[i], base ? base + 1 : found.gl_pathv[i], 0);
+    }
+    globfree(& found);
+    journalDropped = 0;
+    runWorkerPool(cpinManyWorker);
+    if (journalDropped)
+        report("cpin-many: stopped, the files copied since the last commit are dropped \n");
+    else
+        report("cpin-many: %d of %d files copied \n", bulkJobCount - atomic_load(& bulkFailed), bulkJobCount);
+    commandDone = atomic_load(& bulkFailed) == 0 && !journalDropped;
+    freeBulkJobs();
+    setInode1asCurrent();
+}
+
+/**************************************************************************************
+* Copies one file of the source directory of cpout-many into its host path
+* *************************************************************************************/
+static int exportFile(bulkJob * job)
+{
+    inode node = getInodeInfoFromInodeNum(job->inodeNo);
+    int fd_outputFile = open(job->hostPath, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (fd_outputFile < 0)
+    {
+        report(" %s: cannot create the output file \n", job->hostPath);
+        return -1;
+    }
+    if (isLargeFile(& node) == 0)
+        copyoutSmallFile(fd_outputFile, & node);
+    else
+        copyoutLargeFile(fd_outputFile, & node);
+    ftruncate(fd_outputFile, fileSize(& node));
+    close(fd_outputFile);
+    return 0;
+}
+
+/**************************************************************************************
+* Worker of cpout-many
+* *************************************************************************************/
+static void * cpoutManyWorker(void * arg)
+{
+    int job;
+    (void) arg;
+    while ((job = atomic_fetch_add(& bulkNextJob, 1)) < bulkJobCount)
+    {
+        if (exportFile(& bulkJobs[job]) < 0)
+            atomic_fetch_add(& bulkFailed, 1);
+    }
+    return 0;
+}
+
+/**************************************************************************************
+* cpout-many: copies all the plain files of an internal directory into a host directory
+* *************************************************************************************/
+static copyoutMany(char * source, char * dest)
+{
+    char path[2000];
+    char name[15];
+    int i, j;
+    bulkDirInodeNo = resolveBulkDirectory(source);
+    if (bulkDirInodeNo == 0)
+    {
+        report("Source directory doesnt exist in the file system. Cannot proceed..\n");
+        return;
+    }
+    mkdir(dest, 0755);
+    inode dirInode = getInodeInfoFromInodeNum(bulkDirInodeNo);
+    dir *entries = malloc(blockSize);
+    int nblocks = fileExtent(& dirInode);
+    for (i = 0; i < nblocks; i++)
+    {
+        unsigned int blockNo = directoryBlock(& dirInode, i);
+        if (blockNo == 0)
+            continue;
+        readFromFS((off_t) blockNo * blockSize, entries, blockSize);
+        for (j = 0; j < (int) (blockSize / sizeof(dir)); j++)
+        {
+            if (entries[j].inode_no == 0)
+                continue;
+            inode node = getInodeInfoFromInodeNum(entries[j].inode_no);
+            if (isDirectory(& node))
+                continue;
+            memset(name, 0, sizeof(name));
+            strncpy(name, entries[j].file_name, 14);
+            snprintf(path, sizeof(path), "%s/%s", dest, name);
+            addBulkJob(path, name, entries[j].inode_no);
+        }
+    }
+    free(entries);
+    runWorkerPool(cpoutManyWorker);
+    report("cpout-many: %d of %d files copied \n", bulkJobCount - atomic_load(& bulkFailed), bulkJobCount);
+    commandDone = atomic_load(& bulkFailed) == 0;
+    freeBulkJobs();
+}
+
+
+/**************************************************************************************
+* Library interface (v6fs.h): volumes, file handles with offset based read/write and
+* directory operations on top of the functions of the fsaccess commands
+* *************************************************************************************/
+struct V6Volume
+{
+    int isOpen;
+    int openFiles;
+};
+
+struct V6File
+{
+    V6Volume *volume;
+    int inodeNo;
+    inode node;
+    int flags;
+    int group;
+    off_t offset;
+};
+
+//The single volume of the process; its state is kept in the globals above
+static V6Volume openVolume;
+
+//Checks given volume is the open volume of the process
+static int isOpenVolume(V6Volume * volume)
+{
+    return volume == & openVolume && volume->isOpen;
+}
+
+//Refuses a second volume while one is open, as all volume state is shared by the process
+static int volumeAlreadyOpen()
+{
+    if (!imageOpen)
+        return 0;
+    report(" A volume is already open in this process \n");
+    return 1;
+}
+
+//Makes the opened image the volume of the process
+static V6Volume * takeVolume()
+{
+    openVolume.isOpen = 1;
+    openVolume.openFiles = 0;
+    return & openVolume;
+}
+
+//Returns entry i of given indirect block; a missing entry gets a new block, zeroed when it is to be
+//an indirect block itself, and *isNew is set
+static unsigned int mapIndirectEntry(unsigned int indirectBlock, int i, int zeroed, int * isNew)
+{
+    unsigned char entry[sizeof(unsigned int)];
+    unsigned int blockNo = readIndirectEntry(indirectBlock, i);
+    if (blockNo == 0 && (blockNo = getFreeBlockk()) != 0)
+    {
+        if (zeroed)
+            initializeToZero(blockNo);
+        setBlockAddress(entry, 0, blockNo);
+        writeIntoFS((off_t) indirectBlock * blockSize + i * addrSize, entry, addrSize);
+        *isNew = 1;
+    }
+    return blockNo;
+}
+
+//Returns the data block that holds logical block n of given file like bmap(), 0 when the file has no such block
+//With allocate set a missing block is allocated together with the indirect blocks on its way and *isNew tells
+//that it holds no data yet; a small file turns large when its ninth block is allocated
+static unsigned int mapFileBlock(inode * node, off_t n, int allocate, int * isNew)
+{
+    unsigned int entries[MAX_INDIRECT_ENTRIES];
+    unsigned int single, parent;
+    int index = n / indirectEntries;
+    int unused = 0;
+    *isNew = 0;
+    if (!allocate || n < 0 || n >= maxFileBlocks)
+        return bmap(node, n);
+    if (!isLargeFile(node))
+    {
+        if (n < 8)
+        {
+            if (node->addr[n] == 0 && (node->addr[n] = getFreeBlockk()) != 0)
+                *isNew = 1;
+            return node->addr[n];
+        }
+        if ((single = getFreeBlockk()) == 0)
+            return 0;
+        //Move the 8 direct blocks into the first single indirect block
+        memset(entries, 0, indirectEntries * sizeof(unsigned int));
+        memcpy(entries, node->addr, sizeof(node->addr));
+        writeIndirectBlock(single, entries);
+        memset(node->addr, 0, sizeof(node->addr));
+        node->addr[0] = single;
+        setLargeFileBitINode(node);
+    }
+    if (index < singleSlots)
+    {
+        if (node->addr[index] == 0 && (node->addr[index] = getFreeBlockk()) != 0)
+            initializeToZero(node->addr[index]);
+        single = node->addr[index];
+    }
+    else
+    {
+        //The double indirect block, or the triple indirect block and one of its double indirect blocks
+        int slot = singleSlots;
+        index -= singleSlots;
+        if (index >= doubleIndirectEntries)
+        {
+            slot = 7;
+            index -= doubleIndirectEntries;
+        }
+        if (node->addr[slot] == 0 && (node->addr[slot] = getFreeBlockk()) != 0)
+            initializeToZero(node->addr[slot]);
+        parent = node->addr[slot];
+        if (parent != 0 && slot != singleSlots)
+        {
+            parent = mapIndirectEntry(parent, index / doubleIndirectEntries, 1, & unused);
+            index %= doubleIndirectEntries;
+        }
+        if (parent == 0)
+            return 0;
+        single = mapIndirectEntry(parent, index, 1, & unused);
+    }
+    if (single == 0)
+        return 0;
+    return mapIndirectEntry(single, n % indirectEntries, 0, isNew);
+}
+
+/**************************************************************************************
+* Hashed directories: a directory that outgrows its 8 blocks turns large and reaches its
+* blocks through indirect blocks as a large file does. Its logical block 0 holds . and ..
+* and the dirHashHeader, blocks 1 to buckets are the buckets of a hash table of entries.
+* An entry is stored in the bucket of its name hash or, when that one is full, in the next
+* bucket with a free slot (linear probing over buckets, as dirIndex does over slots), so a
+* lookup ends at the first bucket that is not full. The table doubles when 3/4 full
+* *************************************************************************************/
+
+//Checks given directory is a hashed directory
+static int isHashedDirectory(inode * dirInode)
+{
+    return isDirectory(dirInode) && isLargeFile(dirInode);
+}
+
+//Returns the block holding logical block n of given directory, 0 when it has none
+static int directoryBlock(inode * dirInode, int n)
+{
+    return bmap(dirInode, n);
+}
+
+//Reads the header of given hashed directory
+static readDirHashHeader(inode * dirInode, dirHashHeader * header)
+{
+    readFromFS((off_t) directoryBlock(dirInode, 0) * blockSize + 2 * sizeof(dir), header, sizeof(dirHashHeader));
+}
+
+//Writes the header of given hashed directory
+static writeDirHashHeader(inode * dirInode, dirHashHeader * header)
+{
+    writeIntoFS((off_t) directoryBlock(dirInode, 0) * blockSize + 2 * sizeof(dir), header, sizeof(dirHashHeader));
+}
+
+//Returns the home bucket (counted from 0) of given name in a table of given number of buckets
+static int homeBucket(char * name, int buckets)
+{
+    return hashFileName(name) & (buckets - 1);
+}
+
+//Finds given name in the buckets of a hashed directory; returns the bucket holding it with its slot in *slot,
+//-1 when it is not there
+static int findHashedEntry(inode * dirInode, dirHashHeader * header, char * name, int * slot)
+{
+    int perBucket = blockSize / sizeof(dir);
+    int mask = header->buckets - 1;
+    int bucket = homeBucket(name, header->buckets);
+    int probe, j;
+    for (probe = 0; probe < (int) header->buckets; probe++, bucket = (bucket + 1) & mask)
+    {
+        int isFull = 1;
+        buffer *bp = readBuffer(directoryBlock(dirInode, bucket + 1));
+        dir *entries = (dir *) bp->data;
+        for (j = 0; j < perBucket; j++)
+        {
+            if (entries[j].inode_no == 0)
+                isFull = 0;
+            else if (strncmp(entries[j].file_name, name, 14) == 0)
+            {
+                releaseBuffer(bp);
+                *slot = j;
+                return bucket;
+            }
+        }
+        releaseBuffer(bp);
+        if (!isFull)
+            break;
+    }
+    return -1;
+}
+
+//Returns inode number of given name in given hashed directory; 0 if not present
+static int lookupHashedDir(int dirInodeNo, char * name)
+{
+    inode dirInode;
+    dirHashHeader header;
+    dir dots[2];
+    int i, slot;
+    readInode(dirInodeNo, & dirInode);
+    readFromFS((off_t) directoryBlock(& dirInode, 0) * blockSize, dots, sizeof(dots));
+    for (i = 0; i < 2; i++)
+    {
+        if (strncmp(dots[i].file_name, name, 14) == 0)
+            return dots[i].inode_no;
+    }
+    readDirHashHeader(& dirInode, & header);
+    int bucket = findHashedEntry(& dirInode, & header, name, & slot);
+    if (bucket < 0)
+        return 0;
+    dir entry;
+    readFromFS((off_t) directoryBlock(& dirInode, bucket + 1) * blockSize + slot * sizeof(dir), & entry, sizeof(dir));
+    return entry.inode_no;
+}
+
+//Stores given entry in the first bucket with a free slot from the home bucket of its name on; -1 when all are full
+static int placeHashedEntry(inode * dirInode, int buckets, dir * entry)
+{
+    int perBucket = blockSize / sizeof(dir);
+    int bucket = homeBucket(entry->file_name, buckets);
+    int probe, j;
+    for (probe = 0; probe < buckets; probe++, bucket = (bucket + 1) & (buckets - 1))
+    {
+        buffer *bp = readBuffer(directoryBlock(dirInode, bucket + 1));
+        dir *entries = (dir *) bp->data;
+        for (j = 0; j < perBucket && entries[j].inode_no != 0; j++);
+        if (j < perBucket)
+        {
+            entries[j] = *entry;
+            releaseDirtyBuffer(bp);
+            return 0;
+        }
+        releaseBuffer(bp);
+    }
+    return -1;
+}
+
+//Returns the entries other than . and .. of count logical blocks of given directory from block first on
+//in a malloc'd array; *count is set to their number
+static dir * collectDirEntries(inode * dirInode, int first, int nblocks, int * count)
+{
+    int perBlock = blockSize / sizeof(dir);
+    dir *all = malloc((size_t) nblocks * blockSize);
+    int i, j;
+    *count = 0;
+    for (i = first; i < first + nblocks; i++)
+    {
+        unsigned int blockNo = directoryBlock(dirInode, i);
+        if (blockNo == 0)
+            continue;
+        buffer *bp = readBuffer(blockNo);
+        dir *entries = (dir *) bp->data;
+        for (j = 0; j < perBlock; j++)
+        {
+            if (entries[j].inode_no == 0 || !strcmp(entries[j].file_name, ".") || !strcmp(entries[j].file_name, ".."))
+                continue;
+            all[(*count)++] = entries[j];
+        }
+        releaseBuffer(bp);
+    }
+    return all;
+}
+
+//Turns a directory with its 8 blocks full into a hashed directory of DIR_HASH_BUCKETS buckets: as mapFileBlock()
+//does for a file, the 8 blocks move into a new single indirect block as logical blocks 0 to 7, and the blocks up to
+//the last bucket are added. The new blocks are taken before anything is changed; -1 when they are not there
+static int convertToHashedDirectory(inode * dirInode)
+{
+    unsigned int blocks[DIR_HASH_BUCKETS - 6];
+    unsigned int entries[MAX_INDIRECT_ENTRIES];
+    dir dots[2];
+    dirHashHeader header;
+    int i, count;
+    setAllocationGroup(directoryGroup(dirInode));
+    for (i = 0; i < DIR_HASH_BUCKETS - 6; i++)
+    {
+        if ((blocks[i] = getFreeBlockk()) == 0)
+        {
+            while (i-- > 0)
+                markBlockFree(blocks[i]);
+            return -1;
+        }
+    }
+    dir *old = collectDirEntries(dirInode, 0, 8, & count);
+    readFromFS((off_t) dirInode->addr[0] * blockSize, dots, sizeof(dots));
+    memset(entries, 0, indirectEntries * sizeof(unsigned int));
+    memcpy(entries, dirInode->addr, sizeof(dirInode->addr));
+    for (i = 8; i <= DIR_HASH_BUCKETS; i++)
+    {
+        entries[i] = blocks[i - 7];
+    }
+    for (i = 0; i <= DIR_HASH_BUCKETS; i++)
+    {
+        initializeToZero(entries[i]);
+    }
+    writeIndirectBlock(blocks[0], entries);
+    memset(dirInode->addr, 0, sizeof(dirInode->addr));
+    dirInode->addr[0] = blocks[0];
+    setLargeFileBitINode(dirInode);
+    //. and .. stay the first entries of block 0, followed by the header
+    writeIntoFS((off_t) entries[0] * blockSize, dots, sizeof(dots));
+    memset(& header, 0, sizeof(header));
+    header.magic = DIR_HASH_MAGIC;
+    header.buckets = DIR_HASH_BUCKETS;
+    header.count = count;
+    writeDirHashHeader(dirInode, & header);
+    for (i = 0; i < count; i++)
+    {
+        placeHashedEntry(dirInode, DIR_HASH_BUCKETS, & old[i]);
+    }
+    free(old);
+    return 0;
+}
+
+//Doubles the buckets of given hashed directory and rehashes its entries; -1 when no block is left for the new
+//buckets, the table is then kept as it is
+static int growHashedDir(inode * dirInode, dirHashHeader * header)
+{
+    int buckets = header->buckets * 2;
+    int i, count, isNew;
+    if (buckets >= maxFileBlocks)
+        return -1;
+    for (i = header->buckets + 1; i <= buckets; i++)
+    {
+        unsigned int blockNo = mapFileBlock(dirInode, i, 1, & isNew);
+        if (blockNo == 0)
+            return -1;
+        initializeToZero(blockNo);
+    }
+    dir *entries = collectDirEntries(dirInode, 1, header->buckets, & count);
+    for (i = 1; i <= (int) header->buckets; i++)
+    {
+        initializeToZero(directoryBlock(dirInode, i));
+    }
+    header->buckets = buckets;
+    for (i = 0; i < count; i++)
+    {
+        placeHashedEntry(dirInode, buckets, & entries[i]);
+    }
+    free(entries);
+    writeDirHashHeader(dirInode, header);
+    return 0;
+}
+
+//Adds given entry into a hashed directory, doubling its buckets first when they are 3/4 full
+//A table that cannot grow still takes entries while a bucket has a free slot
+static int insertHashedEntry(inode * dirInode, dir * entry)
+{
+    dirHashHeader header;
+    int perBucket = blockSize / sizeof(dir);
+    readDirHashHeader(dirInode, & header);
+    setAllocationGroup(directoryGroup(dirInode));
+    if ((long long) (header.count + 1) * 4 > (long long) header.buckets * perBucket * 3)
+        growHashedDir(dirInode, & header);
+    if (placeHashedEntry(dirInode, header.buckets, entry) < 0)
+        return -1;
+    header.count++;
+    writeDirHashHeader(dirInode, & header);
+    return 0;
+}
+
+//Removes given name from a hashed directory; -1 when it is not there. An entry stored after the bucket of the
+//name that passed that bucket is moved back into the freed slot, bucket by bucket, as removeDirIndexEntry() does
+//for slots; only a full bucket can have been passed, so the run usually ends at the bucket of the name
+static int removeHashedEntry(inode * dirInode, char * name)
+{
+    dirHashHeader header;
+    int perBucket = blockSize / sizeof(dir);
+    int slot, j, probe;
+    readDirHashHeader(dirInode, & header);
+    int mask = header.buckets - 1;
+    int hole = findHashedEntry(dirInode, & header, name, & slot);
+    if (hole < 0)
+        return -1;
+    buffer *bp = readBuffer(directoryBlock(dirInode, hole + 1));
+    dir *entries = (dir *) bp->data;
+    int wasFull = 1;
+    for (j = 0; j < perBucket; j++)
+    {
+        if (entries[j].inode_no == 0)
+            wasFull = 0;
+    }
+    memset(& entries[slot], 0, sizeof(dir));
+    releaseDirtyBuffer(bp);
+    int pos = hole;
+    for (probe = 1; wasFull && probe < (int) header.buckets; probe++)
+    {
+        int moved = -1;
+        pos = (pos + 1) & mask;
+        bp = readBuffer(directoryBlock(dirInode, pos + 1));
+        entries = (dir *) bp->data;
+        for (j = 0; j < perBucket; j++)
+        {
+            if (entries[j].inode_no == 0)
+                wasFull = 0;
+            else if (moved < 0 && ((pos - homeBucket(entries[j].file_name, header.buckets)) & mask) >= ((pos - hole) & mask))
+                moved = j;
+        }
+        if (moved < 0)
+        {
+            releaseBuffer(bp);
+            continue;
+        }
+        buffer *holeBp = readBuffer(directoryBlock(dirInode, hole + 1));
+        ((dir *) holeBp->data)[slot] = entries[moved];
+        releaseDirtyBuffer(holeBp);
+        memset(& entries[moved], 0, sizeof(dir));
+        releaseDirtyBuffer(bp);
+        hole = pos;
+        slot = moved;
+    }
+    header.count--;
+    writeDirHashHeader(dirInode, & header);
+    return 0;
+}
+
+//Creates an empty file of given canonical path in the current directory (the parent of the path)
+//Returns its inode number, -1 when no inode or directory entry is left
+static int createEmptyFile(char * key, char * name)
+{
+    inode node;
+    int inodeNo = getFreeInode();
+    if (inodeNo > superblock.isize)
+    {
+        report(" \n Inode limit reached, no more files or directory can be created \n ");
+        return -1;
+    }
+    if (writeFileNameinDir(inodeNo, name) < 0)
+    {
+        freeInodeNumber(inodeNo);
+        return -1;
+    }
+    setPathCacheEntry(key, current_inode_no, inodeNo);
+    readInode(inodeNo, & node);
+    node.flags = 0;
+    memset(node.addr, 0, sizeof(node.addr));
+    setFileSize(& node, 0);
+    setAllocatedBitINode(& node);
+    writeInode(inodeNo, & node);
+    return inodeNo;
+}
+
+//Starts the I/O engine and the buffer cache on first use of the library; the fsaccess prompt starts them itself
+static startLibrary()
+{
+    if (io != 0)
+        return;
+    startIoEngine(1);
+    initializeBufferCache();
+    selectBitmapScan();
+}
+
+//Opens an existing image as the volume of the process
+V6Volume * v6Open(const char * imagePath)
+{
+    startLibrary();
+    if (volumeAlreadyOpen())
+        return 0;
+    strncpy(imageFile, imagePath, sizeof(imageFile) - 1);
+    if (readV6FS() < 0)
+        return 0;
+    return takeVolume();
+}
+
+//Initializes given image (as initfs) and opens it as the volume of the process; wideBlockSize 0 creates the V6 format
+static V6Volume * createVolume(const char * imagePath, unsigned int blocks, int inodes, int wideBlockSize, int flags)
+{
+    startLibrary();
+    if (volumeAlreadyOpen())
+        return 0;
+    strncpy(imageFile, imagePath, sizeof(imageFile) - 1);
+    commandDone = 0;
+    initializeFS(blocks, inodes, flags & V6_BITMAP, flags & V6_JOURNAL, wideBlockSize);
+    if (!commandDone)
+    {
+        if (imageOpen)
+            closeImage();
+        return 0;
+    }
+    return takeVolume();
+}
+
+//Initializes given image in the V6 format
+V6Volume * v6Create(const char * imagePath, int blocks, int inodes, int flags)
+{
+    return createVolume(imagePath, blocks, inodes, 0, flags);
+}
+
+//Initializes given image in the wide format
+V6Volume * v6CreateWide(const char * imagePath, unsigned int blocks, int inodes, int wideBlockSize, int flags)
+{
+    return createVolume(imagePath, blocks, inodes, wideBlockSize, flags);
+}
+
+//Writes the cached blocks and commits and checkpoints the journal
+int v6Sync(V6Volume * volume)
+{
+    if (!isOpenVolume(volume))
+        return -1;
+    syncFS();
+    syncJournal();
+    syncMappedImage();
+    return 0;
+}
+
+//Syncs the volume and closes its image
+int v6CloseVolume(V6Volume * volume)
+{
+    if (v6Sync(volume) < 0)
+        return -1;
+    closeImage();
+    volume->openFiles = 0;
+    volume->isOpen = 0;
+    return 0;
+}
+
+//Opens the plain file of given path, creating or truncating it as the flags ask
+V6File * v6OpenFile(V6Volume * volume, const char * path, int flags)
+{
+    char key[1000];
+    char *name;
+    V6File *file;
+    if (!isOpenVolume(volume) || canonicalPath((char *) path, key, & name) == 0)
+        return 0;
+    int inodeNo = resolvePath(key);
+    if (inodeNo == -1 && (flags & V6_CREATE) && (flags & V6_WRITE))
+        inodeNo = createEmptyFile(key, name);
+    if (inodeNo <= 0)
+    {
+        if (!(flags & V6_CREATE))
+            report("Given file not exist %s \n", path);
+        setInode1asCurrent();
+        return 0;
+    }
+    file = calloc(1, sizeof(V6File));
+    file->volume = volume;
+    file->inodeNo = inodeNo;
+    file->flags = flags;
+    //Blocks of the file are placed in the allocation group of its directory, as cpin does
+    file->group = directoryGroup(& current_inode);
+    setInode1asCurrent();
+    readInode(inodeNo, & file->node);
+    if (isDirectory(& file->node))
+    {
+        report("Given file is a directory %s \n", path);
+        free(file);
+        return 0;
+    }
+    if ((flags & V6_TRUNCATE) && (flags & V6_WRITE))
+    {
+        rmfile(& file->node);
+        flushFreedBlocks();
+        setAllocatedBitINode(& file->node);
+        writeInode(inodeNo, & file->node);
+    }
+    volume->openFiles++;
+    return file;
+}
+
+//Reads from the file offset; each block is found with bmap()
+ssize_t v6Read(V6File * file, void * data, size_t len)
+{
+    char *dest = data;
+    off_t size = v6Size(file);
+    size_t done = 0;
+    if (!(file->flags & V6_READ))
+        return -1;
+    if (file->offset >= size)
+        return 0;
+    if (len > (size_t) (size - file->offset))
+        len = size - file->offset;
+    while (done < len)
+    {
+        int start = file->offset % blockSize;
+        int n = blockSize - start;
+        if ((size_t) n > len - done)
+            n = len - done;
+        unsigned int blockNo = bmap(& file->node, file->offset / blockSize);
+        if (blockNo != 0)
+            readFromFS((off_t) blockNo * blockSize + start, dest + done, n);
+        else
+            memset(dest + done, 0, n);
+        done += n;
+        file->offset += n;
+    }
+    return done;
+}
+
+//Writes at the file offset; whole blocks go out as data runs past the buffer cache like cpin, a partially
+//written block is read first. A gap between the end of the file and the offset stays a hole
+//The inode, with the new size when the file grew, is written once at the end
+ssize_t v6Write(V6File * file, const void * data, size_t len)
+{
+    char block[MAX_BLOCK_SIZE];
+    const char *src = data;
+    size_t done = 0;
+    int isNew;
+    unsigned int blockNo;
+    if (!(file->flags & V6_WRITE))
+        return -1;
+    off_t size = fileSize(& file->node);
+    setAllocationGroup(file->group);
+    while (done < len)
+    {
+        int start = file->offset % blockSize;
+        int count = blockSize - start;
+        if ((size_t) count > len - done)
+            count = len - done;
+        if ((blockNo = mapFileBlock(& file->node, file->offset / blockSize, 1, & isNew)) == 0)
+            break;
+        if (count < blockSize)
+        {
+            if (isNew)
+                memset(block, 0, blockSize);
+            else
+                readFromFS((off_t) blockNo * blockSize, block, blockSize);
+        }
+        memcpy(block + start, src + done, count);
+        writeDataBlock(blockNo, block);
+        done += count;
+        file->offset += count;
+    }
+    flushDataRun();
+    waitForDataRuns();
+    if (file->offset > size)
+        setFileSize(& file->node, file->offset);
+    writeInode(file->inodeNo, & file->node);
+    return (done > 0 || len == 0) ? (ssize_t) done : -1;
+}
+
+//Moves the file offset
+off_t v6Seek(V6File * file, off_t offset, int whence)
+{
+    off_t base = 0;
+    if (whence == SEEK_CUR)
+        base = file->offset;
+    else if (whence == SEEK_END)
+        base = v6Size(file);
+    if (base + offset < 0)
+        return -1;
+    file->offset = base + offset;
+    return file->offset;
+}
+
+//Returns the size of the file in bytes
+off_t v6Size(V6File * file)
+{
+    return fileSize(& file->node);
+}
+
+//Closes the file; its changes are committed like those of a command
+int v6Close(V6File * file)
+{
+    if (file->flags & V6_WRITE)
+        syncFS();
+    file->volume->openFiles--;
+    free(file);
+    return 0;
+}
+
+//Returns the next entry of given directory in entry; the cursor counts directory entry slots
+int v6ReadDir(V6Volume * volume, const char * path, int * cursor, V6DirEntry * entry)
+{
+    int perBlock = blockSize / sizeof(dir);
+    if (!isOpenVolume(volume))
+        return -1;
+    int inodeNo = resolvePath((char *) path);
+    setInode1asCurrent();
+    if (inodeNo <= 0)
+        return -1;
+    inode dirInode = getInodeInfoFromInodeNum(inodeNo);
+    if (!isDirectory(& dirInode))
+        return -1;
+    int nblocks = fileExtent(& dirInode);
+    while (*cursor < nblocks * perBlock)
+    {
+        dir d;
+        int i = *cursor / perBlock;
+        unsigned int blockNo = directoryBlock(& dirInode, i);
+        if (blockNo == 0)
+        {
+            *cursor = (i + 1) * perBlock;
+            continue;
+        }
+        readFromFS((off_t) blockNo * blockSize + (*cursor % perBlock) * sizeof(dir), & d, sizeof(dir));
+        (*cursor)++;
+        if (d.inode_no == 0)
+            continue;
+        inode node = getInodeInfoFromInodeNum(d.inode_no);
+        entry->inodeNo = d.inode_no;
+        entry->isDirectory = isDirectory(& node);
+        entry->size = fileSize(& node);
+        memset(entry->name, 0, sizeof(entry->name));
+        strncpy(entry->name, d.file_name, 14);
+        return 1;
+    }
+    return 0;
+}
+
+//Starts a command of the fsaccess prompt run for the library; returns 0 when given volume is not open
+static int startCommand(V6Volume * volume)
+{
+    if (!isOpenVolume(volume))
+        return 0;
+    commandDone = 0;
+    journalDropped = 0;
+    return 1;
+}
+
+//Persists the changes of the command as the prompt does after each one; returns 0 when the command
+//completed and the journal kept its changes, -1 otherwise
+static int finishCommand()
+{
+    setInode1asCurrent();
+    syncFS();
+    return (commandDone && !journalDropped) ? 0 : -1;
+}
+
+//Creates a directory as mkdir does
+int v6Mkdir(V6Volume * volume, const char * path)
+{
+    if (!startCommand(volume))
+        return -1;
+    mkdirV6((char *) path);
+    return finishCommand();
+}
+
+//Removes a plain file as rm does
+int v6Unlink(V6Volume * volume, const char * path)
+{
+    if (!startCommand(volume))
+        return -1;
+    removeFileDir((char *) path);
+    return finishCommand();
+}
+
+//Removes a file or a whole directory as rm -r does
+int v6RemoveTree(V6Volume * volume, const char * path)
+{
+    if (!startCommand(volume))
+        return -1;
+    removeTree((char *) path);
+    return finishCommand();
+}
+
+//Copies a host file into the volume as cpin does
+int v6CopyIn(V6Volume * volume, const char * hostPath, const char * path)
+{
+    if (!startCommand(volume))
+        return -1;
+    copyin((char *) hostPath, (char *) path);
+    return finishCommand();
+}
+
+//Copies a file of the volume out to the host as cpout does
+int v6CopyOut(V6Volume * volume, const char * path, const char * hostPath)
+{
+    if (!startCommand(volume))
+        return -1;
+    copyout((char *) path, (char *) hostPath);
+    return finishCommand();
+}
+
+//Copies the host files matching given patterns into a directory of the volume as cpin-many does
+int v6CopyInMany(V6Volume * volume, const char * dirPath, char * const hostPatterns[])
+{
+    if (!startCommand(volume))
+        return -1;
+    copyinMany((char *) dirPath, (char **) hostPatterns);
+    return finishCommand();
+}
+
+//Copies the files of a directory of the volume into a host directory as cpout-many does
+int v6CopyOutMany(V6Volume * volume, const char * dirPath, const char * hostDir)
+{
+    if (!startCommand(volume))
+        return -1;
+    copyoutMany((char *) dirPath, (char *) hostDir);
+    return finishCommand();
+}
+
+//Returns the block and inode usage; the free counts are kept by the allocation groups and the inode bitmap,
+//so nothing is read from V6FileSystem
+int v6Stat(V6Volume * volume, V6VolumeInfo * info)
+{
+    int g, w;
+    if (!isOpenVolume(volume))
+        return -1;
+    memset(info, 0, sizeof(V6VolumeInfo));
+    for (g = 0; g < allocGroupCount; g++)
+    {
+        info->freeBlocks += allocGroups[g].freeCount;
+    }
+    for (w = 0; w < inodeBitmapWords; w++)
+    {
+        info->freeInodes += __builtin_popcountll(~inodeBitmap[w]);
+    }
+    info->blocks = fsBlocks;
+    info->inodes = superblock.isize;
+    info->blockSize = blockSize;
+    info->addressBits = addrSize * 8;
+    info->freeBitmap = bitmapStart != 0;
+    return 0;
+}
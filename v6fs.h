@@ -0,0 +1,111 @@
+/********************************************************************************************************************************************************
+ *
+ * File Name: v6fs.h
+ *
+ * Library interface of the modified Unix V6 file system implemented in fsaccess.c
+ *
+ * How to build it into a program:
+ * 	gcc -c -DV6FS_LIBRARY fsaccess.c -o v6fs.o		(leaves out the main() of the fsaccess prompt)
+ * 	gcc -o program program.c v6fs.o -pthread -lm
+ *
+ * Description:
+ *  A V6Volume stands for an open image with its superblock, bitmaps, buffer cache and journal. That state lives in
+ *  the static variables of fsaccess.c, not in the V6Volume, so it is shared by the whole process:
+ *  - one volume can be open at a time; v6Open and v6Create fail while another volume is open
+ *  - a volume must be used by one thread at a time; none of the functions below may run concurrently
+ *  Functions given a volume that is not open (or already closed) fail.
+ *  Paths are absolute paths inside the volume (/dir/file). Functions return -1 (or 0 for pointers) on failure.
+ *  The library prints nothing and never exits the program; the only symbols it defines are the v6 functions below.
+ *
+*********************************************************************************************************************************************************/
+
+#ifndef V6FS_H
+#define V6FS_H
+
+#include <sys/types.h>
+
+//Flags of v6Create
+#define V6_BITMAP 1
+#define V6_JOURNAL 4
+
+//Flags of v6OpenFile
+#define V6_READ 1
+#define V6_WRITE 2
+#define V6_CREATE 4
+#define V6_TRUNCATE 8
+
+typedef struct V6Volume V6Volume;
+typedef struct V6File V6File;
+
+//One entry of a directory as returned by v6ReadDir
+typedef struct V6DirEntry
+{
+    int inodeNo;
+    int isDirectory;
+    off_t size;
+    char name[15];
+}V6DirEntry;
+
+//Size and free space of a volume as returned by v6Stat
+typedef struct V6VolumeInfo
+{
+    unsigned int blocks;
+    unsigned int freeBlocks;
+    int inodes;
+    int freeInodes;
+    int blockSize;
+    int addressBits;
+    int freeBitmap;
+}V6VolumeInfo;
+
+//Opens an existing image; committed journal transactions are replayed first. Fails while a volume is open
+V6Volume * v6Open(const char * imagePath);
+//Creates (or recreates) an image of given number of blocks and inodes; flags as the initfs options
+//Fails while a volume is open, like v6Open
+V6Volume * v6Create(const char * imagePath, int blocks, int inodes, int flags);
+//Creates an image in the wide format (initfs ... wide): 32 bit block numbers and blocks of blockSize bytes,
+//a power of 2 from 1K to 64K
+V6Volume * v6CreateWide(const char * imagePath, unsigned int blocks, int inodes, int blockSize, int flags);
+//Writes everything cached for the volume into the image
+int v6Sync(V6Volume * volume);
+//Syncs and closes the volume; files still open on it must not be used afterwards
+int v6CloseVolume(V6Volume * volume);
+//Fills info with the number of blocks and inodes of the volume and how many are free; freeBitmap is set when
+//free blocks are kept in a bitmap rather than the V6 free chain
+int v6Stat(V6Volume * volume, V6VolumeInfo * info);
+
+//Opens a plain file; V6_CREATE creates a missing file and V6_TRUNCATE empties it (both need V6_WRITE)
+V6File * v6OpenFile(V6Volume * volume, const char * path, int flags);
+//Reads up to len bytes at the file offset; returns the number of bytes read, 0 at the end of the file
+ssize_t v6Read(V6File * file, void * data, size_t len);
+//Writes len bytes at the file offset, growing the file (a gap before the offset is left as a hole that reads as zeros)
+//Returns the number of bytes written, less than len when the volume is full or the file at its maximum size
+ssize_t v6Write(V6File * file, const void * data, size_t len);
+//Moves the file offset as lseek() does with SEEK_SET, SEEK_CUR or SEEK_END; returns the new offset
+off_t v6Seek(V6File * file, off_t offset, int whence);
+//Returns the size of the file in bytes
+off_t v6Size(V6File * file);
+//Closes the file and commits its changes
+int v6Close(V6File * file);
+
+//Returns the next entry of given directory from *cursor (start with 0) in entry and advances the cursor
+//Returns 1 for an entry, 0 after the last one
+int v6ReadDir(V6Volume * volume, const char * path, int * cursor, V6DirEntry * entry);
+//Creates a directory
+int v6Mkdir(V6Volume * volume, const char * path);
+//Removes a plain file; the file must not be open
+int v6Unlink(V6Volume * volume, const char * path);
+//Removes a file or a directory with everything in it; none of its files may be open
+int v6RemoveTree(V6Volume * volume, const char * path);
+
+//Copies a host file into the volume (cpin); path is the new file, whose directory must exist
+int v6CopyIn(V6Volume * volume, const char * hostPath, const char * path);
+//Copies a plain file of the volume into a host file (cpout)
+int v6CopyOut(V6Volume * volume, const char * path, const char * hostPath);
+//Copies the host files matching the glob patterns of hostPatterns (ended by a null pointer) into a directory of the
+//volume (cpin-many); fails when any of them is not copied
+int v6CopyInMany(V6Volume * volume, const char * dirPath, char * const hostPatterns[]);
+//Copies the plain files of a directory of the volume into a host directory (cpout-many); fails when any is not copied
+int v6CopyOutMany(V6Volume * volume, const char * dirPath, const char * hostDir);
+
+#endif